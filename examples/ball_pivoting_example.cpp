@@ -0,0 +1,36 @@
+#include <cilantro/ball_pivoting.hpp>
+#include <cilantro/io.hpp>
+#include <cilantro/visualizer.hpp>
+#include <cilantro/voxel_grid.hpp>
+
+int main(int argc, char ** argv) {
+    cilantro::PointCloud cloud;
+    readPointCloudFromPLYFile(argv[1], cloud);
+
+    cilantro::VoxelGrid vg(cloud, 0.005);
+    cloud = vg.getDownsampledCloud();
+
+    auto start = std::chrono::high_resolution_clock::now();
+    cilantro::TriangleMesh mesh = cilantro::ballPivotingReconstruction(cloud, 0.01f);
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::milli> reconstruction_time = end - start;
+
+    cilantro::TriangleMeshTopology topology(mesh);
+
+    std::cout << "Reconstruction time: " << reconstruction_time.count() << "ms" << std::endl;
+    std::cout << "Number of faces: " << mesh.getNumberOfFaces() << ", boundary edges: " << topology.getNumberOfBoundaryEdges() << std::endl;
+
+    mesh.removeUnreferencedVertices().computeVertexNormals();
+
+    cilantro::Visualizer viz("BallPivoting example", "disp");
+
+    viz.addTriangleMesh("mesh", mesh.vertices, mesh.getFaceList());
+    viz.addTriangleMeshVertexNormals("mesh", mesh.vertexNormals);
+    if (mesh.hasVertexColors()) viz.addTriangleMeshVertexColors("mesh", mesh.vertexColors);
+
+    while (!viz.wasStopped()){
+        viz.spinOnce();
+    }
+
+    return 0;
+}
@@ -0,0 +1,45 @@
+#include <cilantro/io.hpp>
+#include <iostream>
+
+// Largest per-coordinate error beyond what quantization and float output rounding allow
+float excess_error(const cilantro::PointCloud &orig, const cilantro::PointCloud &decoded, float step) {
+    float excess = 0.0f;
+    for (size_t i = 0; i < orig.size(); i++) {
+        for (size_t k = 0; k < 3; k++) {
+            float tol = 0.5f*step + std::abs(orig.points[i](k))*std::numeric_limits<float>::epsilon();
+            excess = std::max(excess, std::abs(decoded.points[i](k) - orig.points[i](k)) - tol);
+        }
+    }
+    return excess;
+}
+
+int main(int argc, char ** argv) {
+    // Coordinates around 1e4 with a millimeter quantization step: quantized values exceed the float mantissa
+    cilantro::PointCloud cloud;
+    size_t num_points = 100000;
+    float step = 0.001f;
+    cloud.points.resize(num_points);
+    for (size_t i = 0; i < num_points; i++) {
+        cloud.points[i] = Eigen::Vector3f(10000.0f, 10000.0f, 10000.0f) + 10000.0f*Eigen::Vector3f::Random();
+    }
+
+    // Axis-aligned deltas keep the point order
+    cilantro::writePointCloudToCompactFile("compact_axis.cpc", cloud, step, false);
+    cilantro::PointCloud decoded;
+    cilantro::readPointCloudFromCompactFile("compact_axis.cpc", decoded);
+    float axis_excess = (decoded.size() == cloud.size()) ? excess_error(cloud, decoded, step) : std::numeric_limits<float>::infinity();
+    std::cout << "Axis delta: " << decoded.size() << " points, max excess error " << axis_excess << std::endl;
+
+    // A single point per chunk keeps the order for the Morton encoding too
+    cilantro::PointCloud local;
+    local.points.resize(1000);
+    for (size_t i = 0; i < local.size(); i++) {
+        local.points[i] = Eigen::Vector3f(10000.0f, 10000.0f, 10000.0f) + 1000.0f*Eigen::Vector3f::Random().cwiseAbs();
+    }
+    cilantro::writePointCloudToCompactFile("compact_morton.cpc", local, step, true, 1);
+    cilantro::readPointCloudFromCompactFile("compact_morton.cpc", decoded);
+    float morton_excess = (decoded.size() == local.size()) ? excess_error(local, decoded, step) : std::numeric_limits<float>::infinity();
+    std::cout << "Morton delta: " << decoded.size() << " points, max excess error " << morton_excess << std::endl;
+
+    return (axis_excess <= 0.0f && morton_excess <= 0.0f) ? 0 : 1;
+}
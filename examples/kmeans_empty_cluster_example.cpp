@@ -0,0 +1,31 @@
+#include <cilantro/kmeans.hpp>
+#include <iostream>
+
+int main(int argc, char ** argv) {
+    // All points are nearest to the second centroid, so the first cluster is empty after the first assignment
+    std::vector<Eigen::Vector2f> points;
+    points.emplace_back(0.0f, 0.0f);
+    points.emplace_back(1.0f, 0.0f);
+    points.emplace_back(10.0f, 0.0f);
+
+    Eigen::Matrix2Xf centroids(2,2);
+    centroids << 100.0f, 0.0f,
+                 100.0f, 0.0f;
+
+    // The empty cluster takes over the point farthest from the largest cluster's centroid
+    bool ok = true;
+    for (int m = 0; m < 3; m++) {
+        cilantro::KMeans2D::AssignmentMethod method = (m == 0) ? cilantro::KMeans2D::AssignmentMethod::BRUTE_FORCE :
+                                                      (m == 1) ? cilantro::KMeans2D::AssignmentMethod::KD_TREE :
+                                                                 cilantro::KMeans2D::AssignmentMethod::HAMERLY;
+        cilantro::KMeans2D kmc(points);
+        kmc.cluster(centroids, 1, std::numeric_limits<float>::epsilon(), method);
+        const Eigen::Matrix2Xf& res(kmc.getClusterCentroids());
+        std::cout << "Centroids after one iteration:" << std::endl << res << std::endl;
+        if (!res.col(0).isApprox(points[2]) || !res.col(1).isApprox(Eigen::Vector2f(0.5f, 0.0f))) ok = false;
+    }
+
+    std::cout << ((ok) ? "Empty cluster repair OK" : "Empty cluster repair FAILED") << std::endl;
+
+    return (ok) ? 0 : 1;
+}
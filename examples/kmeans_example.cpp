@@ -20,11 +20,11 @@ int main(int argc, char ** argv) {
     size_t k = 250;
     size_t max_iter = 100;
     float tol = std::numeric_limits<float>::epsilon();
-    bool use_kd_tree = true;
+    cilantro::KMeans3D::AssignmentMethod assignment_method = cilantro::KMeans3D::AssignmentMethod::KD_TREE;
 
 
     auto start = std::chrono::high_resolution_clock::now();
-    kmc.cluster(k, max_iter, tol, use_kd_tree);
+    kmc.cluster(k, max_iter, tol, assignment_method);
     auto end = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double, std::milli> elapsed = end - start;
     std::cout << "Clustering time: " << elapsed.count() << "ms" << std::endl;
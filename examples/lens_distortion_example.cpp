@@ -0,0 +1,39 @@
+#include <cilantro/image_point_cloud_conversions.hpp>
+#include <iostream>
+
+int main(int argc, char ** argv) {
+    // Fisheye camera with a horizontal field of view well beyond 180 degrees
+    size_t w = 640, h = 480;
+    Eigen::Matrix3f K;
+    K << 150, 0, 320, 0, 150, 240, 0, 0, 1;
+    Eigen::Matrix<float,5,1> coeffs;
+    coeffs << 0.01f, 0.0f, 0.0f, 0.0f, 0.0f;
+    cilantro::LensDistortion distortion(cilantro::LensDistortion::Model::FISHEYE, coeffs);
+
+    // Constant 1m depth everywhere
+    std::vector<unsigned short> depth_data(w*h, 1000);
+    pangolin::Image<unsigned short> depth_img(depth_data.data(), w, h, w*sizeof(unsigned short));
+
+    cilantro::DepthImageBackProjector projector(w, h, K, distortion);
+
+    // Pixels beyond 90 degrees off the optical axis have no ray in front of the camera
+    std::vector<Eigen::Vector3f> points;
+    projector.depthImageToPoints(depth_img, points, false);
+    size_t num_nan = 0;
+    for (size_t i = 0; i < points.size(); i++) {
+        if (!points[i].allFinite()) num_nan++;
+    }
+    std::cout << "Valid points: " << points.size() << " of " << w*h << " pixels, " << num_nan << " not finite" << std::endl;
+
+    // Invalid pixels are kept as zero points
+    projector.depthImageToPoints(depth_img, points, true);
+    size_t num_zero = 0;
+    num_nan = 0;
+    for (size_t i = 0; i < points.size(); i++) {
+        if (!points[i].allFinite()) num_nan++;
+        if (points[i].isZero()) num_zero++;
+    }
+    std::cout << "All points: " << points.size() << ", " << num_zero << " zero, " << num_nan << " not finite" << std::endl;
+
+    return (num_nan == 0) ? 0 : 1;
+}
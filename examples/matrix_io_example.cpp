@@ -43,5 +43,12 @@ int main(int argc, char ** argv) {
     }
     std::cout << std::endl;
 
+    cilantro::writeEigenMatrixToFile("mat.dat", dok, true);
+
+    cilantro::MemoryMappedDataMatrix<float,Eigen::Dynamic> dok3("mat.dat");
+
+    std::cout << "Mapped:" << std::endl;
+    std::cout << dok3.getMap() << std::endl;
+
     return 0;
 }
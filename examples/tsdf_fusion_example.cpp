@@ -0,0 +1,59 @@
+#include <cilantro/tsdf_volume.hpp>
+#include <cilantro/visualizer.hpp>
+#include <cilantro/image_viewer.hpp>
+
+int main(int argc, char ** argv) {
+    // Intrinsics
+    Eigen::Matrix3f K;
+    K << 528, 0, 320, 0, 528, 240, 0, 0, 1;
+
+    std::string uri = "openni2:[img1=rgb,img2=depth_reg,coloursync=true,closerange=true,holefilter=true]//";
+
+    std::unique_ptr<pangolin::VideoInterface> dok = pangolin::OpenVideo(uri);
+    size_t w = 640, h = 480;
+    unsigned char* img = new unsigned char[dok->SizeBytes()];
+
+    pangolin::Image<Eigen::Matrix<unsigned char,3,1> > rgb_img((Eigen::Matrix<unsigned char,3,1> *)img, w, h, w*sizeof(Eigen::Matrix<unsigned char,3,1>));
+    pangolin::Image<unsigned short> depth_img((unsigned short *)(img+3*w*h), w, h, w*sizeof(unsigned short));
+
+    std::vector<unsigned short> model_depth(w*h);
+    pangolin::Image<unsigned short> model_depth_img(model_depth.data(), w, h, w*sizeof(unsigned short));
+
+    // Static camera: frames are fused in place
+    cilantro::TSDFVolume volume(0.005f, 0.02f);
+    volume.setMaxDepth(2.0f);
+
+    std::vector<Eigen::Vector3f> vertices, vertex_colors;
+    std::vector<std::vector<size_t> > faces;
+
+    std::string win_name = "TSDF fusion demo";
+    pangolin::CreateWindowAndBind(win_name, 1280, 480);
+    pangolin::Display("multi").SetBounds(0.0, 1.0, 0.0, 1.0).SetLayout(pangolin::LayoutEqual)
+            .AddDisplay(pangolin::Display("disp1")).AddDisplay(pangolin::Display("disp2"));
+
+    cilantro::ImageViewer depthv(win_name, "disp1");
+    cilantro::Visualizer meshv(win_name, "disp2");
+
+    size_t frame = 0;
+    while (!meshv.wasStopped() && !depthv.wasStopped()) {
+        dok->GrabNext(img, true);
+        volume.integrate(rgb_img, depth_img, K);
+        volume.raycast(model_depth_img, K);
+
+        if (frame++ % 30 == 0) {
+            volume.extractMesh(vertices, faces, vertex_colors);
+            meshv.addTriangleMesh("mesh", vertices, faces);
+            meshv.addTriangleMeshVertexColors("mesh", vertex_colors);
+        }
+        depthv.setImage(model_depth_img.ptr, w, h, "GRAY16LE");
+
+        meshv.clearRenderArea();
+        meshv.render();
+        depthv.render();
+        pangolin::FinishFrame();
+    }
+
+    delete[] img;
+
+    return 0;
+}
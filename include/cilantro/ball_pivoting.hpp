@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cilantro/triangle_mesh.hpp>
+#include <cilantro/kd_tree.hpp>
+
+namespace cilantro {
+    // Ball pivoting surface reconstruction: a ball of the given radius is rolled over the points, starting from seed
+    // triangles, and every triple it touches without containing other points becomes a face. Requires oriented
+    // normals; faces are counter-clockwise around them. The mesh vertices are the cloud's points (unused ones
+    // included, so that indices are preserved). Neighborhoods are gathered in parallel; pivoting is sequential.
+    TriangleMesh ballPivotingReconstruction(const PointCloud &cloud, float ball_radius);
+
+    TriangleMesh ballPivotingReconstruction(const PointCloud &cloud, const KDTree3D &kd_tree, float ball_radius);
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <map>
+#include <functional>
 #include <cilantro/data_containers.hpp>
 
 namespace cilantro {
@@ -40,6 +41,18 @@ namespace cilantro {
         }
     };
 
+    // For unordered containers keyed by grid coordinates
+    template <typename ScalarT, ptrdiff_t EigenDim>
+    struct EigenVectorHash {
+        inline size_t operator()(const Eigen::Matrix<ScalarT,EigenDim,1> &p) const {
+            size_t seed = 0;
+            for (size_t i = 0; i < p.rows(); i++) {
+                seed ^= std::hash<ScalarT>()(p[i]) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+            }
+            return seed;
+        }
+    };
+
     template <typename ScalarT, ptrdiff_t EigenDim>
     class CartesianGrid {
     public:
@@ -72,14 +85,7 @@ namespace cilantro {
         const std::vector<typename GridBinMapType::iterator>& getOccupiedBinIterators() const { return bin_iterators_; }
 
         const std::vector<size_t>& getPointBinNeighbors(const Eigen::Ref<const Eigen::Matrix<ScalarT,EigenDim,1>> &point) const {
-            Eigen::Matrix<ptrdiff_t,EigenDim,1> grid_coords(data_map_.rows());
-            for (size_t i = 0; i < data_map_.rows(); i++) {
-                ScalarT val = point[i]/bin_size_[i];
-                grid_coords[i] = (ptrdiff_t)val;
-                if (grid_coords[i] > val) grid_coords[i]--;
-//                grid_coords[i] = std::floor(point[i]/bin_size_[i]);
-            }
-            auto it = grid_lookup_table_.find(grid_coords);
+            auto it = grid_lookup_table_.find(getGridCoordinates(point, bin_size_));
             if (it == grid_lookup_table_.end()) return empty_set_of_indices_;
             return it->second;
         }
@@ -89,20 +95,27 @@ namespace cilantro {
         }
 
         Eigen::Matrix<ptrdiff_t,EigenDim,1> getPointGridCoordinates(const Eigen::Ref<const Eigen::Matrix<ScalarT,EigenDim,1>> &point) const {
-            Eigen::Matrix<ptrdiff_t,EigenDim,1> grid_coords(data_map_.rows());
-            for (size_t i = 0; i < data_map_.rows(); i++) {
-                ScalarT val = point[i]/bin_size_[i];
+            return getGridCoordinates(point, bin_size_);
+        }
+
+        Eigen::Matrix<ptrdiff_t,EigenDim,1> getPointGridCoordinates(size_t point_ind) const {
+            return getGridCoordinates(data_map_.col(point_ind), bin_size_);
+        }
+
+        // Grid coordinates (floor of the coordinate-wise ratio) of a point for an arbitrary bin size
+        static inline Eigen::Matrix<ptrdiff_t,EigenDim,1> getGridCoordinates(const Eigen::Ref<const Eigen::Matrix<ScalarT,EigenDim,1>> &point,
+                                                                             const Eigen::Ref<const Eigen::Matrix<ScalarT,EigenDim,1>> &bin_size)
+        {
+            Eigen::Matrix<ptrdiff_t,EigenDim,1> grid_coords(point.rows());
+            for (size_t i = 0; i < point.rows(); i++) {
+                ScalarT val = point[i]/bin_size[i];
                 grid_coords[i] = (ptrdiff_t)val;
                 if (grid_coords[i] > val) grid_coords[i]--;
-//                grid_coords[i] = std::floor(point[i]/bin_size_[i]);
+//                grid_coords[i] = std::floor(point[i]/bin_size[i]);
             }
             return grid_coords;
         }
 
-        Eigen::Matrix<ptrdiff_t,EigenDim,1> getPointGridCoordinates(size_t point_ind) const {
-            return getGridCoordinates(data_map_.col(point_ind));
-        }
-
         Eigen::Matrix<ScalarT,EigenDim,1> getBinCornerCoordinates(const Eigen::Ref<const Eigen::Matrix<ptrdiff_t,EigenDim,1>> &grid_point) const {
             Eigen::Matrix<ScalarT,EigenDim,1> point(data_map_.rows());
             for (size_t i = 0; i < data_map_.rows(); i++) {
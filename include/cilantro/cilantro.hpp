@@ -1,27 +1,36 @@
 #pragma once
 
+#include <cilantro/ball_pivoting.hpp>
 #include <cilantro/cartesian_grid.hpp>
 #include <cilantro/colormap.hpp>
 #include <cilantro/connected_component_segmentation.hpp>
 #include <cilantro/convex_hull.hpp>
+#include <cilantro/convex_hull_native.hpp>
 #include <cilantro/convex_hull_utilities.hpp>
 #include <cilantro/convex_polytope.hpp>
 #include <cilantro/data_containers.hpp>
+#include <cilantro/depth_image_filters.hpp>
 #include <cilantro/image_point_cloud_conversions.hpp>
 #include <cilantro/image_viewer.hpp>
 #include <cilantro/io.hpp>
 #include <cilantro/iterative_closest_point.hpp>
 #include <cilantro/kd_tree.hpp>
 #include <cilantro/kmeans.hpp>
+#include <cilantro/marching_cubes.hpp>
+#include <cilantro/moving_least_squares.hpp>
 #include <cilantro/normal_estimation.hpp>
+#include <cilantro/outlier_removal.hpp>
 #include <cilantro/plane_estimator.hpp>
 #include <cilantro/point_cloud.hpp>
+#include <cilantro/point_sampling.hpp>
 #include <cilantro/principal_component_analysis.hpp>
 #include <cilantro/random_sample_consensus.hpp>
 #include <cilantro/registration.hpp>
 #include <cilantro/renderables.hpp>
 #include <cilantro/rigid_transform_estimator.hpp>
 #include <cilantro/space_region.hpp>
+#include <cilantro/triangle_mesh.hpp>
+#include <cilantro/tsdf_volume.hpp>
 #include <cilantro/visualizer.hpp>
 #include <cilantro/visualizer_handler.hpp>
 #include <cilantro/voxel_grid.hpp>
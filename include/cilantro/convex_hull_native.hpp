@@ -0,0 +1,657 @@
+#pragma once
+
+#include <algorithm>
+#include <cilantro/data_containers.hpp>
+
+namespace cilantro {
+    // Andrew's monotone chain hull of 2D points. Hull points (indices in the input) are in counter-clockwise order,
+    // facet k being the edge from hull point k to hull point k+1; points on the interior of an edge are not hull points.
+    // As in Qhull, area is the perimeter and volume is the enclosed area. Returns false if the points are collinear.
+    template <typename ScalarT>
+    bool convexHull2DFromPoints(const ConstDataMatrixMap<ScalarT,2> &points,
+                                std::vector<size_t> &hull_point_indices,
+                                std::vector<std::vector<size_t>> &facets,
+                                std::vector<std::vector<size_t>> &point_neighbor_facets,
+                                std::vector<std::vector<size_t>> &facet_neighbor_facets,
+                                InequalityMatrix<double,2> &halfspaces,
+                                double &area, double &volume,
+                                bool simplicial_facets = true)
+    {
+        size_t num_points = points.cols();
+        if (num_points < 3) return false;
+
+        // Lexicographic order, ties broken by index
+        std::vector<std::pair<std::pair<ScalarT,ScalarT>,size_t>> sorted(num_points);
+#pragma omp parallel for
+        for (size_t i = 0; i < num_points; i++) {
+            sorted[i] = std::pair<std::pair<ScalarT,ScalarT>,size_t>(std::pair<ScalarT,ScalarT>(points(0,i), points(1,i)), i);
+        }
+        std::sort(sorted.begin(), sorted.end());
+
+        // Lower chain left to right, then upper chain right to left; non left turns are popped
+        std::vector<size_t> hull(2*num_points);
+        size_t k = 0;
+        for (size_t i = 0; i < num_points; i++) {
+            Eigen::Vector2d pt(points.col(sorted[i].second).template cast<double>());
+            while (k >= 2) {
+                Eigen::Vector2d d1(points.col(hull[k-1]).template cast<double>() - points.col(hull[k-2]).template cast<double>());
+                Eigen::Vector2d d2(pt - points.col(hull[k-2]).template cast<double>());
+                if (d1(0)*d2(1) - d1(1)*d2(0) > 0.0) break;
+                k--;
+            }
+            hull[k++] = sorted[i].second;
+        }
+        for (size_t i = num_points - 1, lower_size = k + 1; i-- > 0;) {
+            Eigen::Vector2d pt(points.col(sorted[i].second).template cast<double>());
+            while (k >= lower_size) {
+                Eigen::Vector2d d1(points.col(hull[k-1]).template cast<double>() - points.col(hull[k-2]).template cast<double>());
+                Eigen::Vector2d d2(pt - points.col(hull[k-2]).template cast<double>());
+                if (d1(0)*d2(1) - d1(1)*d2(0) > 0.0) break;
+                k--;
+            }
+            hull[k++] = sorted[i].second;
+        }
+        // The first point closes the chain
+        size_t num_hull_points = (k > 0) ? k - 1 : 0;
+        if (num_hull_points < 3) return false;
+        hull.resize(num_hull_points);
+
+        hull_point_indices.swap(hull);
+        facets.resize(num_hull_points);
+        point_neighbor_facets.resize(num_hull_points);
+        facet_neighbor_facets.resize(num_hull_points);
+        halfspaces.resize(3, num_hull_points);
+        area = 0.0;
+        volume = 0.0;
+        for (size_t i = 0; i < num_hull_points; i++) {
+            size_t next = (i + 1)%num_hull_points;
+            size_t prev = (i + num_hull_points - 1)%num_hull_points;
+            facets[i] = {i, next};
+            point_neighbor_facets[i] = {prev, i};
+            facet_neighbor_facets[i] = {prev, next};
+
+            Eigen::Vector2d p0(points.col(hull_point_indices[i]).template cast<double>());
+            Eigen::Vector2d p1(points.col(hull_point_indices[next]).template cast<double>());
+            Eigen::Vector2d d(p1 - p0);
+            double len = d.norm();
+            halfspaces(0,i) = d(1)/len;
+            halfspaces(1,i) = -d(0)/len;
+            halfspaces(2,i) = -halfspaces.col(i).head(2).dot(p0);
+            area += len;
+            volume += 0.5*(p0(0)*p1(1) - p0(1)*p1(0));
+        }
+
+        return true;
+    }
+
+    // Quickhull in double precision. Points within a distance tolerance (scaled by the coordinate magnitudes) of a
+    // face are not considered outside of it. The initial assignment of points to faces, and the reassignment of large
+    // sets of points whose faces got replaced, run in parallel. Coplanar adjacent triangles are merged into polygonal
+    // facets, dropping the vertices that are left on the interior of an edge.
+    template <typename ScalarT>
+    class QuickHull3D {
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        QuickHull3D(const ConstDataMatrixMap<ScalarT,3> &points)
+                : points_(points), eps_(0.0), visit_stamp_(0), slot_stamp_(0)
+        {}
+
+        ~QuickHull3D() {}
+
+        // See convexHull3DFromPoints
+        bool compute(std::vector<size_t> &hull_point_indices,
+                     std::vector<std::vector<size_t>> &facets,
+                     std::vector<std::vector<size_t>> &point_neighbor_facets,
+                     std::vector<std::vector<size_t>> &facet_neighbor_facets,
+                     InequalityMatrix<double,3> &halfspaces,
+                     double &area, double &volume,
+                     bool simplicial_facets)
+        {
+            faces_.clear();
+            free_faces_.clear();
+            if (!init_simplex_() || !expand_()) return false;
+            return extract_facets_(hull_point_indices, facets, point_neighbor_facets, facet_neighbor_facets, halfspaces, area, volume, simplicial_facets);
+        }
+
+    private:
+        // Counter-clockwise when seen from outside; neighbor k is across the edge from vertex k to vertex (k+1)%3
+        struct Face_ {
+            size_t vertices[3];
+            size_t neighbors[3];
+            Eigen::Vector3d normal;
+            double offset;
+            std::vector<size_t> outside;
+            size_t furthest;
+            double furthestDist;
+            size_t visitStamp;
+            bool deleted;
+        };
+
+        struct HorizonEdge_ {
+            inline HorizonEdge_(size_t source = 0, size_t target = 0, size_t face = 0) : source(source), target(target), face(face) {}
+
+            size_t source;
+            size_t target;
+            size_t face;
+        };
+
+        ConstDataMatrixMap<ScalarT,3> points_;
+        double eps_;
+        size_t visit_stamp_;
+        std::vector<Face_> faces_;
+        // Slots of deleted faces, for reuse
+        std::vector<size_t> free_faces_;
+        std::vector<size_t> pending_;
+
+        // Buffers for point assignment
+        std::vector<size_t> assigned_face_;
+        std::vector<double> assigned_dist_;
+
+        // Per point scratch values, valid where stamped with the current stamp
+        size_t slot_stamp_;
+        std::vector<size_t> slot_stamps_;
+        std::vector<size_t> slots_;
+
+        inline Eigen::Vector3d point_(size_t ind) const { return points_.col(ind).template cast<double>(); }
+
+        inline double distance_(const Face_ &face, const Eigen::Vector3d &pt) const { return face.normal.dot(pt) + face.offset; }
+
+        size_t add_face_(size_t v0, size_t v1, size_t v2) {
+            size_t ind;
+            if (free_faces_.empty()) {
+                ind = faces_.size();
+                faces_.emplace_back();
+            } else {
+                ind = free_faces_.back();
+                free_faces_.pop_back();
+            }
+            Face_& face(faces_[ind]);
+            face.vertices[0] = v0;
+            face.vertices[1] = v1;
+            face.vertices[2] = v2;
+            Eigen::Vector3d p0(point_(v0));
+            face.normal = (point_(v1) - p0).cross(point_(v2) - p0).normalized();
+            face.offset = -face.normal.dot(p0);
+            face.furthest = 0;
+            face.furthestDist = 0.0;
+            face.visitStamp = 0;
+            face.deleted = false;
+            return ind;
+        }
+
+        // Each candidate goes to the first face it is outside of, if any
+        void assign_points_(const std::vector<size_t> &candidates, size_t exclude, const std::vector<size_t> &face_ids) {
+            assigned_face_.resize(candidates.size());
+            assigned_dist_.resize(candidates.size());
+            size_t none = faces_.size();
+#pragma omp parallel for if (candidates.size() >= 4096)
+            for (size_t i = 0; i < candidates.size(); i++) {
+                Eigen::Vector3d pt(point_(candidates[i]));
+                assigned_face_[i] = none;
+                for (size_t j = 0; j < face_ids.size(); j++) {
+                    double dist = distance_(faces_[face_ids[j]], pt);
+                    if (dist > eps_) {
+                        assigned_face_[i] = face_ids[j];
+                        assigned_dist_[i] = dist;
+                        break;
+                    }
+                }
+            }
+
+            for (size_t i = 0; i < candidates.size(); i++) {
+                if (assigned_face_[i] == none || candidates[i] == exclude) continue;
+                Face_& face(faces_[assigned_face_[i]]);
+                face.outside.emplace_back(candidates[i]);
+                if (assigned_dist_[i] > face.furthestDist) {
+                    face.furthestDist = assigned_dist_[i];
+                    face.furthest = candidates[i];
+                }
+            }
+            for (size_t j = 0; j < face_ids.size(); j++) {
+                if (!faces_[face_ids[j]].outside.empty()) pending_.emplace_back(face_ids[j]);
+            }
+        }
+
+        bool init_simplex_() {
+            size_t num_points = points_.cols();
+            if (num_points < 4) return false;
+
+            // Extreme points along the axes (min and max per axis)
+            size_t extremes[6] = {0, 0, 0, 0, 0, 0};
+#pragma omp parallel
+            {
+                size_t extremes_private[6] = {0, 0, 0, 0, 0, 0};
+#pragma omp for nowait
+                for (size_t i = 0; i < num_points; i++) {
+                    for (size_t d = 0; d < 3; d++) {
+                        if (points_(d,i) < points_(d,extremes_private[2*d])) extremes_private[2*d] = i;
+                        if (points_(d,i) > points_(d,extremes_private[2*d+1])) extremes_private[2*d+1] = i;
+                    }
+                }
+#pragma omp critical
+                {
+                    for (size_t d = 0; d < 3; d++) {
+                        if (points_(d,extremes_private[2*d]) < points_(d,extremes[2*d])) extremes[2*d] = extremes_private[2*d];
+                        if (points_(d,extremes_private[2*d+1]) > points_(d,extremes[2*d+1])) extremes[2*d+1] = extremes_private[2*d+1];
+                    }
+                }
+            }
+
+            double scale = 0.0, max_extent = -1.0;
+            size_t v0 = 0, v1 = 0;
+            for (size_t d = 0; d < 3; d++) {
+                double lo = points_(d,extremes[2*d]), hi = points_(d,extremes[2*d+1]);
+                scale += std::max(std::abs(lo), std::abs(hi));
+                if (hi - lo > max_extent) {
+                    max_extent = hi - lo;
+                    v0 = extremes[2*d];
+                    v1 = extremes[2*d+1];
+                }
+            }
+            eps_ = 3.0*std::numeric_limits<double>::epsilon()*scale;
+            if (max_extent <= eps_) return false;
+
+            // Farthest from the line through v0 and v1
+            Eigen::Vector3d p0(point_(v0));
+            Eigen::Vector3d dir((point_(v1) - p0).normalized());
+            size_t v2 = 0;
+            double max_dist = -1.0;
+#pragma omp parallel
+            {
+                size_t ind_private = 0;
+                double max_private = -1.0;
+#pragma omp for nowait
+                for (size_t i = 0; i < num_points; i++) {
+                    double dist = (point_(i) - p0).cross(dir).squaredNorm();
+                    if (dist > max_private) {
+                        max_private = dist;
+                        ind_private = i;
+                    }
+                }
+#pragma omp critical
+                {
+                    if (max_private > max_dist) {
+                        max_dist = max_private;
+                        v2 = ind_private;
+                    }
+                }
+            }
+            if (std::sqrt(max_dist) <= eps_) return false;
+
+            // Farthest from the plane through v0, v1, and v2
+            Eigen::Vector3d normal((point_(v1) - p0).cross(point_(v2) - p0).normalized());
+            size_t v3 = 0;
+            max_dist = -1.0;
+#pragma omp parallel
+            {
+                size_t ind_private = 0;
+                double max_private = -1.0;
+#pragma omp for nowait
+                for (size_t i = 0; i < num_points; i++) {
+                    double dist = std::abs(normal.dot(point_(i) - p0));
+                    if (dist > max_private) {
+                        max_private = dist;
+                        ind_private = i;
+                    }
+                }
+#pragma omp critical
+                {
+                    if (max_private > max_dist) {
+                        max_dist = max_private;
+                        v3 = ind_private;
+                    }
+                }
+            }
+            if (max_dist <= eps_) return false;
+
+            // Tetrahedron with outward faces
+            if (normal.dot(point_(v3) - p0) > 0.0) std::swap(v1, v2);
+            add_face_(v0, v1, v2);
+            add_face_(v0, v3, v1);
+            add_face_(v1, v3, v2);
+            add_face_(v2, v3, v0);
+            for (size_t f = 0; f < 4; f++) {
+                for (size_t k = 0; k < 3; k++) {
+                    size_t source = faces_[f].vertices[k], target = faces_[f].vertices[(k+1)%3];
+                    for (size_t g = 0; g < 4; g++) {
+                        for (size_t j = 0; j < 3; j++) {
+                            if (faces_[g].vertices[j] == target && faces_[g].vertices[(j+1)%3] == source) faces_[f].neighbors[k] = g;
+                        }
+                    }
+                }
+            }
+
+            slot_stamp_ = 0;
+            slot_stamps_.assign(num_points, 0);
+            slots_.resize(num_points);
+
+            std::vector<size_t> candidates(num_points);
+            for (size_t i = 0; i < num_points; i++) candidates[i] = i;
+            std::vector<size_t> face_ids = {0, 1, 2, 3};
+            pending_.clear();
+            assign_points_(candidates, num_points, face_ids);
+
+            return true;
+        }
+
+        // False if the horizon is not a simple loop (numerically inconsistent visibility)
+        bool expand_() {
+            std::vector<size_t> stack, visible, new_faces, orphans;
+            std::vector<HorizonEdge_> horizon;
+
+            while (!pending_.empty()) {
+                size_t f = pending_.back();
+                pending_.pop_back();
+                if (faces_[f].deleted || faces_[f].outside.empty()) continue;
+
+                size_t eye = faces_[f].furthest;
+                Eigen::Vector3d eye_pt(point_(eye));
+
+                // Faces visible from the eye point, and the edges between them and the rest
+                visit_stamp_++;
+                faces_[f].visitStamp = visit_stamp_;
+                stack.assign(1, f);
+                visible.clear();
+                horizon.clear();
+                while (!stack.empty()) {
+                    size_t g = stack.back();
+                    stack.pop_back();
+                    visible.emplace_back(g);
+                    for (size_t k = 0; k < 3; k++) {
+                        size_t n = faces_[g].neighbors[k];
+                        if (faces_[n].visitStamp == visit_stamp_) continue;
+                        if (distance_(faces_[n], eye_pt) > eps_) {
+                            faces_[n].visitStamp = visit_stamp_;
+                            stack.emplace_back(n);
+                        } else {
+                            horizon.emplace_back(faces_[g].vertices[k], faces_[g].vertices[(k+1)%3], n);
+                        }
+                    }
+                }
+
+                orphans.clear();
+                for (size_t i = 0; i < visible.size(); i++) {
+                    Face_& face(faces_[visible[i]]);
+                    face.deleted = true;
+                    orphans.insert(orphans.end(), face.outside.begin(), face.outside.end());
+                    std::vector<size_t>().swap(face.outside);
+                    free_faces_.emplace_back(visible[i]);
+                }
+
+                // Cone of new faces from the horizon to the eye point; slots map horizon sources to their new face
+                slot_stamp_++;
+                new_faces.clear();
+                for (size_t i = 0; i < horizon.size(); i++) {
+                    size_t nf = add_face_(horizon[i].source, horizon[i].target, eye);
+                    faces_[nf].neighbors[0] = horizon[i].face;
+                    Face_& outer(faces_[horizon[i].face]);
+                    for (size_t k = 0; k < 3; k++) {
+                        if (outer.vertices[k] == horizon[i].target && outer.vertices[(k+1)%3] == horizon[i].source) outer.neighbors[k] = nf;
+                    }
+                    if (slot_stamps_[horizon[i].source] == slot_stamp_) return false;
+                    slot_stamps_[horizon[i].source] = slot_stamp_;
+                    slots_[horizon[i].source] = nf;
+                    new_faces.emplace_back(nf);
+                }
+                for (size_t i = 0; i < new_faces.size(); i++) {
+                    size_t target = faces_[new_faces[i]].vertices[1];
+                    if (slot_stamps_[target] != slot_stamp_) return false;
+                    faces_[new_faces[i]].neighbors[1] = slots_[target];
+                    faces_[slots_[target]].neighbors[2] = new_faces[i];
+                }
+
+                assign_points_(orphans, eye, new_faces);
+            }
+
+            return true;
+        }
+
+        inline size_t find_root_(std::vector<size_t> &parents, size_t ind) const {
+            while (parents[ind] != ind) {
+                parents[ind] = parents[parents[ind]];
+                ind = parents[ind];
+            }
+            return ind;
+        }
+
+        bool extract_facets_(std::vector<size_t> &hull_point_indices,
+                             std::vector<std::vector<size_t>> &facets,
+                             std::vector<std::vector<size_t>> &point_neighbor_facets,
+                             std::vector<std::vector<size_t>> &facet_neighbor_facets,
+                             InequalityMatrix<double,3> &halfspaces,
+                             double &area, double &volume,
+                             bool simplicial_facets)
+        {
+            size_t num_points = points_.cols();
+            size_t num_faces = faces_.size();
+
+            // Group coplanar adjacent faces
+            std::vector<size_t> parents(num_faces);
+            for (size_t f = 0; f < num_faces; f++) parents[f] = f;
+            for (size_t f = 0; f < num_faces; f++) {
+                if (faces_[f].deleted) continue;
+                for (size_t k = 0; k < 3; k++) {
+                    size_t n = faces_[f].neighbors[k];
+                    if (n < f) continue;
+                    size_t opposite_f = faces_[f].vertices[(k+2)%3], opposite_n = 0;
+                    for (size_t j = 0; j < 3; j++) {
+                        if (faces_[n].vertices[j] != faces_[f].vertices[k] && faces_[n].vertices[j] != faces_[f].vertices[(k+1)%3]) opposite_n = faces_[n].vertices[j];
+                    }
+                    if (std::abs(distance_(faces_[f], point_(opposite_n))) <= eps_ && std::abs(distance_(faces_[n], point_(opposite_f))) <= eps_) {
+                        parents[find_root_(parents, n)] = find_root_(parents, f);
+                    }
+                }
+            }
+
+            std::vector<size_t> group_ids(num_faces, num_faces);
+            size_t num_groups = 0;
+            for (size_t f = 0; f < num_faces; f++) {
+                if (faces_[f].deleted) continue;
+                size_t root = find_root_(parents, f);
+                if (group_ids[root] == num_faces) group_ids[root] = num_groups++;
+                group_ids[f] = group_ids[root];
+            }
+
+            // Directed boundary edges of each group, with the group across them, sorted by group
+            std::vector<size_t> edge_offsets(num_groups + 1, 0);
+            for (size_t f = 0; f < num_faces; f++) {
+                if (faces_[f].deleted) continue;
+                for (size_t k = 0; k < 3; k++) {
+                    if (group_ids[faces_[f].neighbors[k]] != group_ids[f]) edge_offsets[group_ids[f] + 1]++;
+                }
+            }
+            for (size_t g = 0; g < num_groups; g++) edge_offsets[g+1] += edge_offsets[g];
+            std::vector<HorizonEdge_> edges(edge_offsets[num_groups]);
+            std::vector<size_t> fill(edge_offsets.begin(), edge_offsets.end() - 1);
+            for (size_t f = 0; f < num_faces; f++) {
+                if (faces_[f].deleted) continue;
+                for (size_t k = 0; k < 3; k++) {
+                    size_t n = faces_[f].neighbors[k];
+                    if (group_ids[n] == group_ids[f]) continue;
+                    edges[fill[group_ids[f]]++] = HorizonEdge_(faces_[f].vertices[k], faces_[f].vertices[(k+1)%3], group_ids[n]);
+                }
+            }
+
+            // Chain the boundary edges into loops; a vertex whose two edges border the same group lies on the
+            // interior of an edge of the polytope
+            std::vector<size_t> loop_offsets(num_groups + 1, 0);
+            std::vector<size_t> loop_vertices;
+            loop_vertices.reserve(edges.size());
+            std::vector<size_t> chain;
+            std::vector<bool> is_vertex(num_points, false);
+            for (size_t g = 0; g < num_groups; g++) {
+                size_t begin = edge_offsets[g], end = edge_offsets[g+1];
+                slot_stamp_++;
+                for (size_t e = begin; e < end; e++) {
+                    if (slot_stamps_[edges[e].source] == slot_stamp_) return false;
+                    slot_stamps_[edges[e].source] = slot_stamp_;
+                    slots_[edges[e].source] = e;
+                }
+                chain.clear();
+                size_t e = begin;
+                do {
+                    chain.emplace_back(e);
+                    if (slot_stamps_[edges[e].target] != slot_stamp_) return false;
+                    e = slots_[edges[e].target];
+                } while (e != begin && chain.size() <= end - begin);
+                if (chain.size() != end - begin) return false;
+
+                for (size_t i = 0; i < chain.size(); i++) {
+                    if (edges[chain[(i + chain.size() - 1)%chain.size()]].face == edges[chain[i]].face) continue;
+                    loop_vertices.emplace_back(edges[chain[i]].source);
+                    is_vertex[edges[chain[i]].source] = true;
+                }
+                loop_offsets[g+1] = loop_vertices.size();
+                if (loop_offsets[g+1] - loop_offsets[g] < 3) return false;
+            }
+
+            // Compact vertex indexing, in input order
+            std::vector<size_t> vertex_index(num_points);
+            hull_point_indices.clear();
+            for (size_t i = 0; i < num_points; i++) {
+                if (!is_vertex[i]) continue;
+                vertex_index[i] = hull_point_indices.size();
+                hull_point_indices.emplace_back(i);
+            }
+            size_t num_hull_points = hull_point_indices.size();
+
+            Eigen::Vector3d interior(Eigen::Vector3d::Zero());
+            for (size_t i = 0; i < num_hull_points; i++) interior += point_(hull_point_indices[i]);
+            interior /= (double)num_hull_points;
+
+            // Facet planes from Newell's normals; triangles of a fan share the plane of their polygon
+            size_t num_facets = (simplicial_facets) ? loop_vertices.size() - 2*num_groups : num_groups;
+            facets.resize(num_facets);
+            halfspaces.resize(4, num_facets);
+            area = 0.0;
+            volume = 0.0;
+            size_t facet_ind = 0;
+            for (size_t g = 0; g < num_groups; g++) {
+                const size_t * loop = loop_vertices.data() + loop_offsets[g];
+                size_t loop_size = loop_offsets[g+1] - loop_offsets[g];
+                Eigen::Vector3d newell(Eigen::Vector3d::Zero()), centroid(Eigen::Vector3d::Zero());
+                for (size_t i = 0; i < loop_size; i++) {
+                    Eigen::Vector3d curr(point_(loop[i]));
+                    newell += curr.cross(point_(loop[(i+1)%loop_size]));
+                    centroid += curr;
+                }
+                centroid /= (double)loop_size;
+                double facet_area = 0.5*newell.norm();
+                Eigen::Vector4d hs;
+                hs.head(3) = newell.normalized();
+                hs(3) = -hs.head(3).dot(centroid);
+                area += facet_area;
+                volume -= facet_area*(hs.head(3).dot(interior) + hs(3))/3.0;
+
+                if (simplicial_facets) {
+                    for (size_t i = 2; i < loop_size; i++) {
+                        facets[facet_ind] = {vertex_index[loop[0]], vertex_index[loop[i-1]], vertex_index[loop[i]]};
+                        halfspaces.col(facet_ind++) = hs;
+                    }
+                } else {
+                    facets[facet_ind].resize(loop_size);
+                    for (size_t i = 0; i < loop_size; i++) facets[facet_ind][i] = vertex_index[loop[i]];
+                    halfspaces.col(facet_ind++) = hs;
+                }
+            }
+
+            // Adjacency; neighbor k of a facet is across the edge from its vertex k to its vertex k+1, and is found
+            // among the facets around vertex k+1
+            point_neighbor_facets.assign(num_hull_points, std::vector<size_t>());
+            for (size_t f = 0; f < num_facets; f++) {
+                for (size_t i = 0; i < facets[f].size(); i++) point_neighbor_facets[facets[f][i]].emplace_back(f);
+            }
+            facet_neighbor_facets.resize(num_facets);
+            for (size_t f = 0; f < num_facets; f++) {
+                size_t facet_size = facets[f].size();
+                facet_neighbor_facets[f].resize(facet_size);
+                for (size_t i = 0; i < facet_size; i++) {
+                    size_t source = facets[f][i], target = facets[f][(i+1)%facet_size];
+                    bool found = false;
+                    for (size_t j = 0; j < point_neighbor_facets[target].size() && !found; j++) {
+                        const std::vector<size_t>& other(facets[point_neighbor_facets[target][j]]);
+                        for (size_t k = 0; k < other.size(); k++) {
+                            if (other[k] == target && other[(k+1)%other.size()] == source) {
+                                facet_neighbor_facets[f][i] = point_neighbor_facets[target][j];
+                                found = true;
+                                break;
+                            }
+                        }
+                    }
+                    if (!found) return false;
+                }
+            }
+
+            return true;
+        }
+    };
+
+    // Facets are counter-clockwise when seen from outside (triangle fans of the polygonal ones if simplicial_facets is
+    // set), and hull points are in input order. Returns false if the points are coplanar, or if the construction ran
+    // into numerically inconsistent input (in which case Qhull should be used instead).
+    template <typename ScalarT>
+    bool convexHull3DFromPoints(const ConstDataMatrixMap<ScalarT,3> &points,
+                                std::vector<size_t> &hull_point_indices,
+                                std::vector<std::vector<size_t>> &facets,
+                                std::vector<std::vector<size_t>> &point_neighbor_facets,
+                                std::vector<std::vector<size_t>> &facet_neighbor_facets,
+                                InequalityMatrix<double,3> &halfspaces,
+                                double &area, double &volume,
+                                bool simplicial_facets = true)
+    {
+        return QuickHull3D<ScalarT>(points).compute(hull_point_indices, facets, point_neighbor_facets, facet_neighbor_facets, halfspaces, area, volume, simplicial_facets);
+    }
+
+    // Compile time selection of the native hull for EigenDim, if there is one
+    template <typename ScalarT, ptrdiff_t EigenDim>
+    struct NativeConvexHull {
+        static const bool isAvailable = false;
+
+        static inline bool compute(const ConstDataMatrixMap<ScalarT,EigenDim> &,
+                                   std::vector<size_t> &,
+                                   std::vector<std::vector<size_t>> &,
+                                   std::vector<std::vector<size_t>> &,
+                                   std::vector<std::vector<size_t>> &,
+                                   InequalityMatrix<double,EigenDim> &,
+                                   double &, double &,
+                                   bool)
+        {
+            return false;
+        }
+    };
+
+    template <typename ScalarT>
+    struct NativeConvexHull<ScalarT,2> {
+        static const bool isAvailable = true;
+
+        static inline bool compute(const ConstDataMatrixMap<ScalarT,2> &points,
+                                   std::vector<size_t> &hull_point_indices,
+                                   std::vector<std::vector<size_t>> &facets,
+                                   std::vector<std::vector<size_t>> &point_neighbor_facets,
+                                   std::vector<std::vector<size_t>> &facet_neighbor_facets,
+                                   InequalityMatrix<double,2> &halfspaces,
+                                   double &area, double &volume,
+                                   bool simplicial_facets)
+        {
+            return convexHull2DFromPoints<ScalarT>(points, hull_point_indices, facets, point_neighbor_facets, facet_neighbor_facets, halfspaces, area, volume, simplicial_facets);
+        }
+    };
+
+    template <typename ScalarT>
+    struct NativeConvexHull<ScalarT,3> {
+        static const bool isAvailable = true;
+
+        static inline bool compute(const ConstDataMatrixMap<ScalarT,3> &points,
+                                   std::vector<size_t> &hull_point_indices,
+                                   std::vector<std::vector<size_t>> &facets,
+                                   std::vector<std::vector<size_t>> &point_neighbor_facets,
+                                   std::vector<std::vector<size_t>> &facet_neighbor_facets,
+                                   InequalityMatrix<double,3> &halfspaces,
+                                   double &area, double &volume,
+                                   bool simplicial_facets)
+        {
+            return convexHull3DFromPoints<ScalarT>(points, hull_point_indices, facets, point_neighbor_facets, facet_neighbor_facets, halfspaces, area, volume, simplicial_facets);
+        }
+    };
+}
@@ -5,6 +5,7 @@
 #include <cilantro/3rd_party/libqhullcpp/QhullFacetList.h>
 #include <cilantro/3rd_party/libqhullcpp/QhullVertexSet.h>
 #include <cilantro/3rd_party/eigen_quadprog/eiquadprog.hpp>
+#include <cilantro/convex_hull_native.hpp>
 #include <cilantro/principal_component_analysis.hpp>
 
 namespace cilantro {
@@ -315,6 +316,198 @@ namespace cilantro {
         return true;
     }
 
+    // Marks the points that satisfy all inequalities (a.x + b + offset <= 0) of at least one group of consecutive
+    // columns of halfspaces, group g spanning columns group_offsets[g] to group_offsets[g+1]-1. Points are processed in
+    // parallel tiles, transposed so that each inequality is evaluated over the whole tile on contiguous coordinate
+    // arrays, with a running max per point. Every few inequalities, the points that already violate one are compacted
+    // away (once they are the majority), and the group is abandoned once none is left.
+    template <typename ScalarT, ptrdiff_t EigenDim>
+    void computeHalfspaceIntersectionUnionMembership(const ConstInequalityDataMatrixMap<ScalarT,EigenDim> &halfspaces,
+                                                     const std::vector<size_t> &group_offsets,
+                                                     const ConstDataMatrixMap<ScalarT,EigenDim> &points,
+                                                     Eigen::Matrix<bool,1,Eigen::Dynamic> &mask,
+                                                     ScalarT offset = 0.0)
+    {
+        const size_t tile_size = 256;
+        const size_t check_interval = 4;
+        size_t dim = points.rows();
+        size_t num_points = points.cols();
+        size_t num_groups = (group_offsets.empty()) ? 0 : group_offsets.size() - 1;
+
+        mask.setConstant(1, num_points, false);
+        if (num_groups == 0) return;
+
+        size_t num_tiles = (num_points + tile_size - 1)/tile_size;
+        Eigen::Matrix<ScalarT,Eigen::Dynamic,EigenDim> tile, candidates;
+        std::vector<size_t> candidate_ids;
+        Eigen::Array<ScalarT,Eigen::Dynamic,1> values, max_values;
+#pragma omp parallel for private (tile, candidates, candidate_ids, values, max_values)
+        for (size_t t = 0; t < num_tiles; t++) {
+            size_t start = t*tile_size;
+            size_t len = std::min(tile_size, num_points - start);
+            tile = points.middleCols(start, len).transpose();
+            candidates.resize(len, dim);
+            candidate_ids.resize(len);
+            values.resize(len);
+            max_values.resize(len);
+
+            for (size_t g = 0; g < num_groups; g++) {
+                // Points already inside a previous group are done
+                size_t num_candidates = 0;
+                for (size_t j = 0; j < len; j++) {
+                    if (mask(start + j)) continue;
+                    candidates.row(num_candidates) = tile.row(j);
+                    candidate_ids[num_candidates++] = j;
+                }
+                if (num_candidates == 0) break;
+
+                max_values.head(num_candidates).setConstant(-std::numeric_limits<ScalarT>::infinity());
+                for (size_t h = group_offsets[g]; h < group_offsets[g+1] && num_candidates > 0; h++) {
+                    values.head(num_candidates).setConstant(halfspaces(dim,h) + offset);
+                    for (size_t d = 0; d < dim; d++) {
+                        values.head(num_candidates) += halfspaces(d,h)*candidates.col(d).head(num_candidates).array();
+                    }
+                    max_values.head(num_candidates) = max_values.head(num_candidates).max(values.head(num_candidates));
+
+                    if ((h - group_offsets[g]) % check_interval != check_interval - 1) continue;
+                    size_t num_left = (max_values.head(num_candidates) <= (ScalarT)0.0).count();
+                    if (2*num_left > num_candidates) continue;
+                    size_t k = 0;
+                    for (size_t j = 0; j < num_candidates; j++) {
+                        if (max_values(j) > (ScalarT)0.0) continue;
+                        if (k < j) {
+                            candidates.row(k) = candidates.row(j);
+                            candidate_ids[k] = candidate_ids[j];
+                            max_values(k) = max_values(j);
+                        }
+                        k++;
+                    }
+                    num_candidates = k;
+                }
+
+                for (size_t j = 0; j < num_candidates; j++) {
+                    if (max_values(j) <= (ScalarT)0.0) mask(start + candidate_ids[j]) = true;
+                }
+            }
+        }
+    }
+
+    // Indices of the true entries, in increasing order; tiles are counted and written in parallel
+    inline std::vector<size_t> getIndexMaskTrueIndices(const Eigen::Matrix<bool,1,Eigen::Dynamic> &mask) {
+        const size_t tile_size = 4096;
+        size_t num_tiles = (mask.cols() + tile_size - 1)/tile_size;
+
+        std::vector<size_t> tile_offsets(num_tiles + 1, 0);
+#pragma omp parallel for
+        for (size_t t = 0; t < num_tiles; t++) {
+            size_t end = std::min((t+1)*tile_size, (size_t)mask.cols());
+            size_t count = 0;
+            for (size_t i = t*tile_size; i < end; i++) count += mask(i);
+            tile_offsets[t+1] = count;
+        }
+        for (size_t t = 0; t < num_tiles; t++) {
+            tile_offsets[t+1] += tile_offsets[t];
+        }
+
+        std::vector<size_t> indices(tile_offsets[num_tiles]);
+#pragma omp parallel for
+        for (size_t t = 0; t < num_tiles; t++) {
+            size_t end = std::min((t+1)*tile_size, (size_t)mask.cols());
+            size_t k = tile_offsets[t];
+            for (size_t i = t*tile_size; i < end; i++) {
+                if (mask(i)) indices[k++] = i;
+            }
+        }
+
+        return indices;
+    }
+    // Akl-Toussaint heuristic: points strictly inside the hull of the extreme points along all directions with
+    // coordinates in {-1,0,1} (axes and diagonals) cannot be hull vertices. The extreme points are found over parallel
+    // tiles of projections and their hull is computed natively, so this only applies in 2D and 3D, to inputs large
+    // enough to benefit. Returns false (and no indices) if the filter does not apply.
+    template <typename ScalarT, ptrdiff_t EigenDim>
+    bool getConvexHullCandidatePointIndices(const ConstDataMatrixMap<ScalarT,EigenDim> &points,
+                                            std::vector<size_t> &candidate_indices)
+    {
+        const size_t tile_size = 1024;
+        size_t dim = points.rows();
+        size_t num_points = points.cols();
+
+        candidate_indices.clear();
+        if (!NativeConvexHull<ScalarT,EigenDim>::isAvailable) return false;
+
+        // Base 3 digits of the direction index, skipping the zero vector (whose digits are all 1)
+        size_t num_directions = 1;
+        for (size_t d = 0; d < dim; d++) num_directions *= 3;
+        num_directions--;
+        if (num_points < 16*num_directions) return false;
+        Eigen::Matrix<ScalarT,EigenDim,Eigen::Dynamic> directions(dim, num_directions);
+        for (size_t i = 0; i < num_directions; i++) {
+            size_t code = (i < num_directions/2) ? i : i + 1;
+            for (size_t d = 0; d < dim; d++) {
+                directions(d,i) = (ScalarT)((ptrdiff_t)(code%3) - 1);
+                code /= 3;
+            }
+        }
+
+        size_t num_tiles = (num_points + tile_size - 1)/tile_size;
+        std::vector<size_t> extremes(num_directions, 0);
+        std::vector<ScalarT> max_projections(num_directions, -std::numeric_limits<ScalarT>::infinity());
+#pragma omp parallel
+        {
+            std::vector<size_t> extremes_private(num_directions, 0);
+            std::vector<ScalarT> max_projections_private(num_directions, -std::numeric_limits<ScalarT>::infinity());
+            Eigen::Matrix<ScalarT,Eigen::Dynamic,Eigen::Dynamic> projections;
+#pragma omp for nowait
+            for (size_t t = 0; t < num_tiles; t++) {
+                size_t start = t*tile_size;
+                size_t len = std::min(tile_size, num_points - start);
+                projections.noalias() = points.middleCols(start, len).transpose()*directions;
+                for (size_t i = 0; i < num_directions; i++) {
+                    ptrdiff_t ind;
+                    ScalarT max_val = projections.col(i).maxCoeff(&ind);
+                    if (max_val > max_projections_private[i]) {
+                        max_projections_private[i] = max_val;
+                        extremes_private[i] = start + ind;
+                    }
+                }
+            }
+#pragma omp critical
+            {
+                for (size_t i = 0; i < num_directions; i++) {
+                    if (max_projections_private[i] > max_projections[i]) {
+                        max_projections[i] = max_projections_private[i];
+                        extremes[i] = extremes_private[i];
+                    }
+                }
+            }
+        }
+        std::sort(extremes.begin(), extremes.end());
+        extremes.erase(std::unique(extremes.begin(), extremes.end()), extremes.end());
+        if (extremes.size() < dim+1) return false;
+
+        PointMatrix<ScalarT,EigenDim> extreme_points(dim, extremes.size());
+        for (size_t i = 0; i < extremes.size(); i++) {
+            extreme_points.col(i) = points.col(extremes[i]);
+        }
+        std::vector<size_t> hull_point_indices;
+        std::vector<std::vector<size_t>> facets, point_neighbor_facets, facet_neighbor_facets;
+        InequalityMatrix<double,EigenDim> halfspaces_d;
+        double area, volume;
+        if (!NativeConvexHull<ScalarT,EigenDim>::compute(extreme_points, hull_point_indices, facets, point_neighbor_facets, facet_neighbor_facets, halfspaces_d, area, volume, false)) return false;
+
+        // Keep everything that is not inside by more than the evaluation error
+        ScalarT tol = 8*dim*std::numeric_limits<ScalarT>::epsilon()*extreme_points.cwiseAbs().maxCoeff();
+        InequalityMatrix<ScalarT,EigenDim> halfspaces(halfspaces_d.template cast<ScalarT>());
+        std::vector<size_t> group_offsets = {0, (size_t)halfspaces.cols()};
+        Eigen::Matrix<bool,1,Eigen::Dynamic> mask;
+        computeHalfspaceIntersectionUnionMembership<ScalarT,EigenDim>(halfspaces, group_offsets, points, mask, tol);
+        mask = (!mask.array()).matrix();
+        candidate_indices = getIndexMaskTrueIndices(mask);
+
+        return true;
+    }
+
     template <typename InputScalarT, typename OutputScalarT, ptrdiff_t EigenDim>
     bool halfspaceIntersectionFromVertices(const ConstDataMatrixMap<InputScalarT,EigenDim> &vertices,
                                            PointMatrix<OutputScalarT,EigenDim> &polytope_vertices,
@@ -339,13 +532,44 @@ namespace cilantro {
             return false;
         }
 
+        // Only candidates for hull vertices are passed on (native 3D quickhull discards interior points as it goes, so
+        // there the prefilter only pays off ahead of Qhull)
+        bool use_native = NativeConvexHull<InputScalarT,EigenDim>::isAvailable && merge_tol == 0.0;
+        std::vector<size_t> candidate_indices;
+        PointMatrix<InputScalarT,EigenDim> candidates_holder;
+        ConstDataMatrixMap<InputScalarT,EigenDim> input(vertices);
+        if ((dim == 2 || !use_native) && getConvexHullCandidatePointIndices<InputScalarT,EigenDim>(vertices, candidate_indices)) {
+            num_points = candidate_indices.size();
+            candidates_holder.resize(dim, num_points);
+#pragma omp parallel for
+            for (size_t i = 0; i < num_points; i++) {
+                candidates_holder.col(i) = vertices.col(candidate_indices[i]);
+            }
+            new (&input) ConstDataMatrixMap<InputScalarT,EigenDim>(candidates_holder);
+        }
+
+        // Native 2D/3D hull for full dimensional input; Qhull handles merging with a tolerance and everything else
+        if (use_native) {
+            std::vector<size_t> hull_point_indices;
+            std::vector<std::vector<size_t>> facets, point_neighbor_facets, facet_neighbor_facets;
+            InequalityMatrix<double,EigenDim> halfspaces_d;
+            if (NativeConvexHull<InputScalarT,EigenDim>::compute(input, hull_point_indices, facets, point_neighbor_facets, facet_neighbor_facets, halfspaces_d, area, volume, false)) {
+                polytope_vertices.resize(dim, hull_point_indices.size());
+                for (size_t i = 0; i < hull_point_indices.size(); i++) {
+                    polytope_vertices.col(i) = input.col(hull_point_indices[i]).template cast<OutputScalarT>();
+                }
+                facet_halfspaces = halfspaces_d.template cast<OutputScalarT>();
+                return true;
+            }
+        }
+
         // Avoid unnecessary copy/cast if input data is double
         Eigen::Matrix<double,EigenDim,Eigen::Dynamic> data_holder(dim,0);
         Eigen::Map<Eigen::Matrix<double,EigenDim,Eigen::Dynamic>> vert_data(NULL, dim, 0);
         if (std::is_same<InputScalarT, double>::value) {
-            new (&vert_data) Eigen::Map<Eigen::Matrix<double,EigenDim,Eigen::Dynamic>>((double *)vertices.data(), dim, num_points);
+            new (&vert_data) Eigen::Map<Eigen::Matrix<double,EigenDim,Eigen::Dynamic>>((double *)input.data(), dim, num_points);
         } else {
-            data_holder = vertices.template cast<double>();
+            data_holder = input.template cast<double>();
             new (&vert_data) Eigen::Map<Eigen::Matrix<double,EigenDim,Eigen::Dynamic>>(data_holder.data(), dim, num_points);
         }
 
@@ -392,7 +616,7 @@ namespace cilantro {
                 size_t vert_ind = 0;
                 polytope_vertices.resize(dim, qh.vertexCount());
                 for (auto vi = qh.vertexList().begin(); vi != qh.vertexList().end(); ++vi) {
-                    polytope_vertices.col(vert_ind++) = vertices.col(vi->point().id()).template cast<OutputScalarT>();
+                    polytope_vertices.col(vert_ind++) = input.col(vi->point().id()).template cast<OutputScalarT>();
                 }
 
                 // Populate facet halfspaces
@@ -411,7 +635,7 @@ namespace cilantro {
             } else if (true_dim == 0) {
                 // Handle special case (single point)
                 polytope_vertices.resize(dim,1);
-                polytope_vertices.col(0) = vertices.col(0).template cast<OutputScalarT>();
+                polytope_vertices.col(0) = input.col(0).template cast<OutputScalarT>();
                 facet_halfspaces_d.setZero(dim+1,2*dim);
                 area = 0.0;
                 volume = 0.0;
@@ -422,8 +646,8 @@ namespace cilantro {
                 double max_val = proj_vert.row(0).maxCoeff(&ind_max);
 
                 polytope_vertices.resize(dim,2);
-                polytope_vertices.col(0) = vertices.col(ind_min).template cast<OutputScalarT>();
-                polytope_vertices.col(1) = vertices.col(ind_max).template cast<OutputScalarT>();
+                polytope_vertices.col(0) = input.col(ind_min).template cast<OutputScalarT>();
+                polytope_vertices.col(1) = input.col(ind_max).template cast<OutputScalarT>();
 
                 facet_halfspaces_d.setZero(dim+1,2*dim);
                 facet_halfspaces_d(0,0) = -1.0;
@@ -507,13 +731,36 @@ namespace cilantro {
             return;
         }
 
+        // Only candidates for hull vertices are passed on (native 3D quickhull discards interior points as it goes, so
+        // there the prefilter only pays off ahead of Qhull)
+        bool use_native = NativeConvexHull<ScalarT,EigenDim>::isAvailable && merge_tol == 0.0;
+        std::vector<size_t> candidate_indices;
+        PointMatrix<ScalarT,EigenDim> candidates_holder;
+        ConstDataMatrixMap<ScalarT,EigenDim> input(vertices);
+        if ((dim == 2 || !use_native) && getConvexHullCandidatePointIndices<ScalarT,EigenDim>(vertices, candidate_indices)) {
+            num_points = candidate_indices.size();
+            candidates_holder.resize(dim, num_points);
+#pragma omp parallel for
+            for (size_t i = 0; i < num_points; i++) {
+                candidates_holder.col(i) = vertices.col(candidate_indices[i]);
+            }
+            new (&input) ConstDataMatrixMap<ScalarT,EigenDim>(candidates_holder);
+        }
+
+        if (use_native) {
+            std::vector<size_t> hull_point_indices;
+            std::vector<std::vector<size_t>> facets, point_neighbor_facets, facet_neighbor_facets;
+            InequalityMatrix<double,EigenDim> halfspaces_d;
+            if (NativeConvexHull<ScalarT,EigenDim>::compute(input, hull_point_indices, facets, point_neighbor_facets, facet_neighbor_facets, halfspaces_d, area, volume, false)) return;
+        }
+
         // Avoid unnecessary copy/cast if input data is double
         Eigen::Matrix<double,EigenDim,Eigen::Dynamic> data_holder(dim,0);
         Eigen::Map<Eigen::Matrix<double,EigenDim,Eigen::Dynamic>> vert_data(NULL, dim, 0);
         if (std::is_same<ScalarT, double>::value) {
-            new (&vert_data) Eigen::Map<Eigen::Matrix<double,EigenDim,Eigen::Dynamic>>((double *)vertices.data(), dim, num_points);
+            new (&vert_data) Eigen::Map<Eigen::Matrix<double,EigenDim,Eigen::Dynamic>>((double *)input.data(), dim, num_points);
         } else {
-            data_holder = vertices.template cast<double>();
+            data_holder = input.template cast<double>();
             new (&vert_data) Eigen::Map<Eigen::Matrix<double,EigenDim,Eigen::Dynamic>>(data_holder.data(), dim, num_points);
         }
 
@@ -600,13 +847,48 @@ namespace cilantro {
             return false;
         }
 
+        // Only candidates for hull points are passed on and hull point indices are mapped back to the input (native 3D
+        // quickhull discards interior points as it goes, so there the prefilter only pays off ahead of Qhull)
+        bool use_native = NativeConvexHull<InputScalarT,EigenDim>::isAvailable && merge_tol == 0.0;
+        std::vector<size_t> candidate_indices;
+        PointMatrix<InputScalarT,EigenDim> candidates_holder;
+        ConstDataMatrixMap<InputScalarT,EigenDim> input(points);
+        if ((dim == 2 || !use_native) && getConvexHullCandidatePointIndices<InputScalarT,EigenDim>(points, candidate_indices)) {
+            num_points = candidate_indices.size();
+            candidates_holder.resize(dim, num_points);
+#pragma omp parallel for
+            for (size_t i = 0; i < num_points; i++) {
+                candidates_holder.col(i) = points.col(candidate_indices[i]);
+            }
+            new (&input) ConstDataMatrixMap<InputScalarT,EigenDim>(candidates_holder);
+        }
+
+        // Native 2D/3D hull; Qhull handles merging with a tolerance, other dimensions, and (through the rank check
+        // below) degenerate input
+        if (use_native) {
+            InequalityMatrix<double,EigenDim> halfspaces_d;
+            if (NativeConvexHull<InputScalarT,EigenDim>::compute(input, hull_point_indices, facets, point_neighbor_facets, facet_neighbor_facets, halfspaces_d, area, volume, simplicial_facets)) {
+                // Input and output may be the same matrix
+                PointMatrix<OutputScalarT,EigenDim> hull_points_tmp(dim, hull_point_indices.size());
+                for (size_t i = 0; i < hull_point_indices.size(); i++) {
+                    hull_points_tmp.col(i) = input.col(hull_point_indices[i]).template cast<OutputScalarT>();
+                }
+                hull_points.swap(hull_points_tmp);
+                halfspaces = halfspaces_d.template cast<OutputScalarT>();
+                if (!candidate_indices.empty()) {
+                    for (size_t i = 0; i < hull_point_indices.size(); i++) hull_point_indices[i] = candidate_indices[hull_point_indices[i]];
+                }
+                return true;
+            }
+        }
+
         // Avoid unnecessary copy/cast if input data is double
         Eigen::Matrix<double,EigenDim,Eigen::Dynamic> data_holder(dim,0);
         Eigen::Map<Eigen::Matrix<double,EigenDim,Eigen::Dynamic>> vert_data(NULL, dim, 0);
         if (std::is_same<InputScalarT, double>::value) {
-            new (&vert_data) Eigen::Map<Eigen::Matrix<double,EigenDim,Eigen::Dynamic>>((double *)points.data(), dim, num_points);
+            new (&vert_data) Eigen::Map<Eigen::Matrix<double,EigenDim,Eigen::Dynamic>>((double *)input.data(), dim, num_points);
         } else {
-            data_holder = points.template cast<double>();
+            data_holder = input.template cast<double>();
             new (&vert_data) Eigen::Map<Eigen::Matrix<double,EigenDim,Eigen::Dynamic>>(data_holder.data(), dim, num_points);
         }
 
@@ -673,7 +955,7 @@ namespace cilantro {
                 point_neighbor_facets[k][i++] = fid_to_fidx[(*fi).id()];
             }
 
-            hull_point_indices[k] = vi->point().id();
+            hull_point_indices[k] = (candidate_indices.empty()) ? vi->point().id() : candidate_indices[vi->point().id()];
             k++;
         }
 
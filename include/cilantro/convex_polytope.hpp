@@ -103,20 +103,15 @@ namespace cilantro {
         }
 
         Eigen::Matrix<bool,1,Eigen::Dynamic> getInteriorPointsIndexMask(const ConstDataMatrixMap<OutputScalarT,EigenDim> &points, OutputScalarT offset = 0.0) const {
-            Eigen::Matrix<bool,1,Eigen::Dynamic> mask(1,points.cols());
-            for (size_t i = 0; i < points.cols(); i++) {
-                mask(i) = containsPoint(points.col(i), offset);
-            }
+            Eigen::Matrix<bool,1,Eigen::Dynamic> mask;
+            std::vector<size_t> group_offsets(2, 0);
+            group_offsets[1] = halfspaces_.cols();
+            computeHalfspaceIntersectionUnionMembership<OutputScalarT,EigenDim>(halfspaces_, group_offsets, points, mask, offset);
             return mask;
         }
 
         std::vector<size_t> getInteriorPointIndices(const ConstDataMatrixMap<OutputScalarT,EigenDim> &points, OutputScalarT offset = 0.0) const {
-            std::vector<size_t> indices;
-            indices.reserve(points.cols());
-            for (size_t i = 0; i < points.cols(); i++) {
-                if (containsPoint(points.col(i), offset)) indices.emplace_back(i);
-            }
-            return indices;
+            return getIndexMaskTrueIndices(getInteriorPointsIndexMask(points, offset));
         }
 
         inline const std::vector<std::vector<size_t>>& getFacetVertexIndices() const { return faces_; }
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <pangolin/pangolin.h>
+
+namespace cilantro {
+    // All filters work in place and treat zero depth as invalid: invalid pixels are never used as support and are
+    // left invalid. Depth differences are given in raw depth units.
+
+    // Separable approximation of the bilateral filter (a horizontal pass followed by a vertical one)
+    void bilateralFilterDepthImage(pangolin::Image<unsigned short> &depth_img,
+                                   size_t radius,
+                                   float sigma_spatial,
+                                   float sigma_depth);
+
+    // Median of the valid pixels in a (2*radius+1)x(2*radius+1) window
+    void medianFilterDepthImage(pangolin::Image<unsigned short> &depth_img, size_t radius = 1);
+
+    // Invalidates pixels that differ from some valid pixel in their neighborhood by more than max_jump_ratio times
+    // their own depth (flying pixels at depth discontinuities)
+    void removeDepthImageJumpEdges(pangolin::Image<unsigned short> &depth_img, float max_jump_ratio, size_t radius = 1);
+
+    // Optional filtering stage for depth image conversions; a zero radius (or ratio) disables a filter. Filters run
+    // in the order median, bilateral, jump edge removal.
+    struct DepthImageFilterParameters {
+        inline DepthImageFilterParameters() : medianRadius(0),
+                                              bilateralRadius(0),
+                                              bilateralSigmaSpatial(2.0f),
+                                              bilateralSigmaDepth(30.0f),
+                                              jumpEdgeRadius(1),
+                                              maxJumpRatio(0.0f)
+        {}
+
+        inline bool isEnabled() const { return medianRadius > 0 || bilateralRadius > 0 || (jumpEdgeRadius > 0 && maxJumpRatio > 0.0f); }
+
+        size_t medianRadius;
+        size_t bilateralRadius;
+        float bilateralSigmaSpatial;
+        float bilateralSigmaDepth;
+        size_t jumpEdgeRadius;
+        float maxJumpRatio;
+    };
+
+    void filterDepthImage(pangolin::Image<unsigned short> &depth_img, const DepthImageFilterParameters &params);
+}
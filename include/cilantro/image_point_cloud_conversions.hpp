@@ -1,9 +1,103 @@
 #pragma once
 
 #include <cilantro/point_cloud.hpp>
+#include <cilantro/depth_image_filters.hpp>
 #include <pangolin/pangolin.h>
 
 namespace cilantro {
+    // Lens distortion acting on normalized image coordinates. Coefficients are (k1,k2,p1,p2,k3) for the
+    // radial-tangential model and (k1,k2,k3,k4) for the equidistant fisheye model (OpenCV conventions).
+    struct LensDistortion {
+        enum struct Model {NONE, RADIAL_TANGENTIAL, FISHEYE};
+
+        LensDistortion();
+        LensDistortion(const Model &model, const Eigen::Matrix<float,5,1> &coefficients);
+
+        Eigen::Vector2f distort(const Eigen::Vector2f &point) const;
+
+        // Iterative inversion of distort
+        Eigen::Vector2f undistort(const Eigen::Vector2f &point, size_t max_iter = 20) const;
+
+        inline bool isIdentity() const { return model == Model::NONE || coefficients.isZero(); }
+
+        Model model;
+        Eigen::Matrix<float,5,1> coefficients;
+    };
+
+    // Back-projects depth (and RGB) images of a fixed size using ray tables precomputed for the given intrinsics.
+    // Raw depth values are multiplied by the depth scale; pixels outside [min_depth,max_depth] are treated as invalid.
+    class DepthImageBackProjector {
+    public:
+        DepthImageBackProjector(size_t width, size_t height, const Eigen::Matrix3f &intr, float depth_scale = 0.001f);
+
+        // Undistorted rays are precomputed per pixel
+        DepthImageBackProjector(size_t width, size_t height, const Eigen::Matrix3f &intr, const LensDistortion &distortion, float depth_scale = 0.001f);
+
+        inline size_t getImageWidth() const { return width_; }
+        inline size_t getImageHeight() const { return height_; }
+        inline const Eigen::Matrix3f& getIntrinsics() const { return intr_; }
+        inline const LensDistortion& getDistortion() const { return distortion_; }
+
+        inline float getDepthScale() const { return depth_scale_; }
+        inline DepthImageBackProjector& setDepthScale(float depth_scale) { depth_scale_ = depth_scale; return *this; }
+
+        inline float getMinDepth() const { return min_depth_; }
+        inline DepthImageBackProjector& setMinDepth(float min_depth) { min_depth_ = min_depth; return *this; }
+
+        inline float getMaxDepth() const { return max_depth_; }
+        inline DepthImageBackProjector& setMaxDepth(float max_depth) { max_depth_ = max_depth; return *this; }
+
+        // Filters applied to (a copy of) the input depth before back-projection
+        inline const DepthImageFilterParameters& getDepthFilterParameters() const { return filter_params_; }
+        inline DepthImageBackProjector& setDepthFilterParameters(const DepthImageFilterParameters &params) { filter_params_ = params; return *this; }
+
+        void depthImageToPoints(const pangolin::Image<unsigned short> &depth_img,
+                                std::vector<Eigen::Vector3f> &points,
+                                bool keep_invalid = false) const;
+
+        inline void depthImageToPointCloud(const pangolin::Image<unsigned short> &depth_img,
+                                           PointCloud &cloud,
+                                           bool keep_invalid = false) const
+        {
+            depthImageToPoints(depth_img, cloud.points, keep_invalid);
+        }
+
+        void RGBDImagesToPointsColors(const pangolin::Image<Eigen::Matrix<unsigned char,3,1> > &rgb_img,
+                                      const pangolin::Image<unsigned short> &depth_img,
+                                      std::vector<Eigen::Vector3f> &points,
+                                      std::vector<Eigen::Vector3f> &colors,
+                                      bool keep_invalid = false) const;
+
+        inline void RGBDImagesToPointCloud(const pangolin::Image<Eigen::Matrix<unsigned char,3,1> > &rgb_img,
+                                           const pangolin::Image<unsigned short> &depth_img,
+                                           PointCloud &cloud,
+                                           bool keep_invalid = false) const
+        {
+            RGBDImagesToPointsColors(rgb_img, depth_img, cloud.points, cloud.colors, keep_invalid);
+        }
+
+    private:
+        size_t width_;
+        size_t height_;
+        Eigen::Matrix3f intr_;
+        LensDistortion distortion_;
+        float depth_scale_;
+        float min_depth_;
+        float max_depth_;
+        DepthImageFilterParameters filter_params_;
+
+        // Ray (x/z, y/z) components per image column and row, or per pixel (row major) under distortion, along with
+        // whether each pixel's ray could be undistorted
+        bool per_pixel_rays_;
+        std::vector<float> x_rays_;
+        std::vector<float> y_rays_;
+        std::vector<unsigned char> valid_rays_;
+
+        const pangolin::Image<unsigned short>& get_filtered_depth_(const pangolin::Image<unsigned short> &depth_img,
+                                                                  std::vector<unsigned short> &filtered_data,
+                                                                  pangolin::Image<unsigned short> &filtered_img) const;
+    };
+
     void depthImageToPoints(const pangolin::Image<unsigned short> &depth_img,
                             const Eigen::Matrix3f &intr,
                             std::vector<Eigen::Vector3f> &points,
@@ -33,44 +127,58 @@ namespace cilantro {
         RGBDImagesToPointsColors(rgb_img, depth_img, intr, cloud.points, cloud.colors, keep_invalid);
     }
 
+    // Projections are rasterized in parallel into a z-buffer keeping the nearest point per pixel; each point covers the
+    // pixels within a disk of its projected point_radius (a single pixel if zero). Up to 2^32 points are projected.
     void pointsToDepthImage(const std::vector<Eigen::Vector3f> &points,
                             const Eigen::Matrix3f &intr,
-                            pangolin::Image<unsigned short> &depth_img);
+                            pangolin::Image<unsigned short> &depth_img,
+                            const LensDistortion &distortion = LensDistortion(),
+                            float point_radius = 0.0f);
 
     inline void pointCloudToDepthImage(const PointCloud &cloud,
                                        const Eigen::Matrix3f &intr,
-                                       pangolin::Image<unsigned short> &depth_img)
+                                       pangolin::Image<unsigned short> &depth_img,
+                                       const LensDistortion &distortion = LensDistortion(),
+                                       float point_radius = 0.0f)
     {
-        pointsToDepthImage(cloud.points, intr, depth_img);
+        pointsToDepthImage(cloud.points, intr, depth_img, distortion, point_radius);
     }
 
     void pointsToDepthImage(const std::vector<Eigen::Vector3f> &points,
                             const Eigen::Matrix3f &intr,
                             const Eigen::Matrix3f &rot_mat,
                             const Eigen::Vector3f &t_vec,
-                            pangolin::Image<unsigned short> &depth_img);
+                            pangolin::Image<unsigned short> &depth_img,
+                            const LensDistortion &distortion = LensDistortion(),
+                            float point_radius = 0.0f);
 
     inline void pointCloudToDepthImage(const PointCloud &cloud,
                                        const Eigen::Matrix3f &intr,
                                        const Eigen::Matrix3f &rot_mat,
                                        const Eigen::Vector3f &t_vec,
-                                       pangolin::Image<unsigned short> &depth_img)
+                                       pangolin::Image<unsigned short> &depth_img,
+                                       const LensDistortion &distortion = LensDistortion(),
+                                       float point_radius = 0.0f)
     {
-        pointsToDepthImage(cloud.points, intr, rot_mat, t_vec, depth_img);
+        pointsToDepthImage(cloud.points, intr, rot_mat, t_vec, depth_img, distortion, point_radius);
     }
 
     void pointsColorsToRGBDImages(const std::vector<Eigen::Vector3f> &points,
                                   const std::vector<Eigen::Vector3f> &colors,
                                   const Eigen::Matrix3f &intr,
                                   pangolin::Image<Eigen::Matrix<unsigned char,3,1> > &rgb_img,
-                                  pangolin::Image<unsigned short> &depth_img);
+                                  pangolin::Image<unsigned short> &depth_img,
+                                  const LensDistortion &distortion = LensDistortion(),
+                                  float point_radius = 0.0f);
 
     inline void pointCloudToRGBDImages(const PointCloud &cloud,
                                        const Eigen::Matrix3f &intr,
                                        pangolin::Image<Eigen::Matrix<unsigned char,3,1> > &rgb_img,
-                                       pangolin::Image<unsigned short> &depth_img)
+                                       pangolin::Image<unsigned short> &depth_img,
+                                       const LensDistortion &distortion = LensDistortion(),
+                                       float point_radius = 0.0f)
     {
-        pointsColorsToRGBDImages(cloud.points, cloud.colors, intr, rgb_img, depth_img);
+        pointsColorsToRGBDImages(cloud.points, cloud.colors, intr, rgb_img, depth_img, distortion, point_radius);
     }
 
 
@@ -80,41 +188,53 @@ namespace cilantro {
                                   const Eigen::Matrix3f &rot_mat,
                                   const Eigen::Vector3f &t_vec,
                                   pangolin::Image<Eigen::Matrix<unsigned char,3,1> > &rgb_img,
-                                  pangolin::Image<unsigned short> &depth_img);
+                                  pangolin::Image<unsigned short> &depth_img,
+                                  const LensDistortion &distortion = LensDistortion(),
+                                  float point_radius = 0.0f);
 
     inline void pointCloudToRGBDImages(const PointCloud &cloud,
                                        const Eigen::Matrix3f &intr,
                                        const Eigen::Matrix3f &rot_mat,
                                        const Eigen::Vector3f &t_vec,
                                        pangolin::Image<Eigen::Matrix<unsigned char,3,1> > &rgb_img,
-                                       pangolin::Image<unsigned short> &depth_img)
+                                       pangolin::Image<unsigned short> &depth_img,
+                                       const LensDistortion &distortion = LensDistortion(),
+                                       float point_radius = 0.0f)
     {
-        pointsColorsToRGBDImages(cloud.points, cloud.colors, intr, rot_mat, t_vec, rgb_img, depth_img);
+        pointsColorsToRGBDImages(cloud.points, cloud.colors, intr, rot_mat, t_vec, rgb_img, depth_img, distortion, point_radius);
     }
 
     void pointsToIndexMap(const std::vector<Eigen::Vector3f> &points,
                           const Eigen::Matrix3f &intr,
-                          pangolin::Image<size_t> &index_map);
+                          pangolin::Image<size_t> &index_map,
+                          const LensDistortion &distortion = LensDistortion(),
+                          float point_radius = 0.0f);
 
     inline void pointCloudToIndexMap(const PointCloud &cloud,
                                      const Eigen::Matrix3f &intr,
-                                     pangolin::Image<size_t> &index_map)
+                                     pangolin::Image<size_t> &index_map,
+                                     const LensDistortion &distortion = LensDistortion(),
+                                     float point_radius = 0.0f)
     {
-        pointsToIndexMap(cloud.points, intr, index_map);
+        pointsToIndexMap(cloud.points, intr, index_map, distortion, point_radius);
     }
 
     void pointsToIndexMap(const std::vector<Eigen::Vector3f> &points,
                           const Eigen::Matrix3f &intr,
                           const Eigen::Matrix3f &rot_mat,
                           const Eigen::Vector3f &t_vec,
-                          pangolin::Image<size_t> &index_map);
+                          pangolin::Image<size_t> &index_map,
+                          const LensDistortion &distortion = LensDistortion(),
+                          float point_radius = 0.0f);
 
     inline void pointCloudToIndexMap(const PointCloud &cloud,
                                      const Eigen::Matrix3f &intr,
                                      const Eigen::Matrix3f &rot_mat,
                                      const Eigen::Vector3f &t_vec,
-                                     pangolin::Image<size_t> &index_map)
+                                     pangolin::Image<size_t> &index_map,
+                                     const LensDistortion &distortion = LensDistortion(),
+                                     float point_radius = 0.0f)
     {
-        pointsToIndexMap(cloud.points, intr, rot_mat, t_vec, index_map);
+        pointsToIndexMap(cloud.points, intr, rot_mat, t_vec, index_map, distortion, point_radius);
     }
 }
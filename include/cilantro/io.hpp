@@ -1,13 +1,126 @@
 #pragma once
 
 #include <cilantro/point_cloud.hpp>
+#include <cilantro/data_containers.hpp>
 #include <fstream>
+#include <memory>
+#include <type_traits>
 
 namespace cilantro {
+    // Read-only memory mapping of a whole file (RAII)
+    class MemoryMappedFile {
+    public:
+        MemoryMappedFile();
+        MemoryMappedFile(const std::string &file_name);
+        MemoryMappedFile(MemoryMappedFile &&other);
+        MemoryMappedFile& operator=(MemoryMappedFile &&other);
+        ~MemoryMappedFile();
+
+        MemoryMappedFile(const MemoryMappedFile &) = delete;
+        MemoryMappedFile& operator=(const MemoryMappedFile &) = delete;
+
+        bool open(const std::string &file_name);
+        void close();
+
+        // Access pattern hints for byte range [begin,end)
+        void prefetch(size_t begin, size_t end) const;
+        void evict(size_t begin, size_t end) const;
+
+        inline bool isOpen() const { return is_open_; }
+        inline const char * data() const { return data_; }
+        inline size_t size() const { return size_; }
+
+    private:
+        bool is_open_;
+        const char * data_;
+        size_t size_;
+    };
+
+    // Binary little endian files are parsed directly from a memory mapping; other encodings go through tinyply
     void readPointCloudFromPLYFile(const std::string &file_name, PointCloud &cloud);
 
     void writePointCloudToPLYFile(const std::string &file_name, const PointCloud &cloud, bool binary = true);
 
+    // Reads the vertices of a binary little endian PLY file in fixed size chunks; the next chunk is decoded on a
+    // background thread while the current one is being processed, so at most two chunks are held in memory
+    class PLYPointCloudStreamReader {
+    public:
+        PLYPointCloudStreamReader(size_t chunk_size = 1048576);
+        PLYPointCloudStreamReader(const std::string &file_name, size_t chunk_size = 1048576);
+        ~PLYPointCloudStreamReader();
+
+        PLYPointCloudStreamReader(const PLYPointCloudStreamReader &) = delete;
+        PLYPointCloudStreamReader& operator=(const PLYPointCloudStreamReader &) = delete;
+
+        bool open(const std::string &file_name);
+        void close();
+
+        // Replaces the contents of chunk with the next block of points; returns false when the file is exhausted
+        bool readNextChunk(PointCloud &chunk);
+
+        inline bool isOpen() const { return !!state_; }
+        inline size_t getChunkSize() const { return chunk_size_; }
+        inline PLYPointCloudStreamReader& setChunkSize(size_t chunk_size) { chunk_size_ = std::max(chunk_size, (size_t)1); return *this; }
+
+        size_t getNumberOfPoints() const;
+        size_t getNumberOfPointsRead() const;
+        bool hasNormals() const;
+        bool hasColors() const;
+
+    private:
+        struct State_;
+
+        size_t chunk_size_;
+        std::unique_ptr<State_> state_;
+
+        void request_next_chunk_(PointCloud buffer);
+    };
+
+    // Compact native point cloud format, stored in independently (and concurrently) coded chunks of chunk_size points.
+    // A positive position_quantization_step stores positions as fixed point deltas (when morton_order is set, points
+    // are reordered within each chunk along a Morton curve for tighter deltas); zero keeps exact float positions.
+    // Normals are octahedrally encoded in 2x16 bits and colors are stored as 8 bits per channel.
+    bool writePointCloudToCompactFile(const std::string &file_name,
+                                      const PointCloud &cloud,
+                                      float position_quantization_step = 0.0f,
+                                      bool morton_order = true,
+                                      size_t chunk_size = 65536);
+
+    bool readPointCloudFromCompactFile(const std::string &file_name, PointCloud &cloud);
+
+    namespace internal {
+        // Text matrix parsing helpers for readEigenMatrixFromFile (not part of the API): rows are non-empty lines that
+        // do not start with '#', values are separated by spaces, tabs, commas or semicolons
+        void splitASCIIIntoRanges(const char * data, size_t size, size_t range_size, std::vector<size_t> &bounds);
+
+        size_t countASCIIRows(const char * begin, const char * end);
+
+        size_t countASCIIFirstRowValues(const char * begin, const char * end);
+
+        // Moves ptr to the first value of the next row; returns false if there is none
+        bool skipToASCIIRow(const char *&ptr, const char * end);
+
+        // Moves ptr past the end of the current row; returns false if any value remains on it
+        bool finishASCIIRow(const char *&ptr, const char * end);
+
+        bool parseASCIIValue(const char *&ptr, const char * end, double &val);
+
+        inline bool parseASCIIValue(const char *&ptr, const char * end, float &val) {
+            double tmp;
+            if (!parseASCIIValue(ptr, end, tmp)) return false;
+            val = (float)tmp;
+            return true;
+        }
+
+        template<typename ScalarT>
+        inline typename std::enable_if<std::is_integral<ScalarT>::value, bool>::type parseASCIIValue(const char *&ptr, const char * end, ScalarT &val) {
+            double tmp;
+            if (!parseASCIIValue(ptr, end, tmp)) return false;
+            val = (ScalarT)tmp;
+            return true;
+        }
+    }
+
     template<class Matrix>
     void readEigenMatrixFromFile(const std::string &file_name, Matrix &matrix, bool binary = true) {
         if (binary) {
@@ -19,31 +132,53 @@ namespace cilantro {
             in.read((char*)matrix.data(), rows*cols*sizeof(typename Matrix::Scalar));
             in.close();
         } else {
-            std::ifstream in(file_name.c_str(), std::ios::in);
-
-            // Read file contents into a vector
-            std::string line;
-            typename Matrix::Scalar d;
-            std::vector<typename Matrix::Scalar> v;
-            size_t n_rows = 0;
-            while (getline(in, line)) {
-                n_rows++;
-                std::stringstream input_line(line);
-                while (!input_line.eof()) {
-                    input_line >> d;
-                    v.emplace_back(d);
-                }
+            MemoryMappedFile file(file_name);
+            if (!file.isOpen()) {
+                matrix.resize(0, 0);
+                return;
             }
-            in.close();
+            file.prefetch(0, file.size());
+
+            // Count rows per line aligned range and values on the first row
+            std::vector<size_t> bounds, range_rows;
+            internal::splitASCIIIntoRanges(file.data(), file.size(), 1048576, bounds);
+            size_t num_ranges = bounds.size() - 1;
+            range_rows.resize(num_ranges + 1, 0);
+#pragma omp parallel for schedule(dynamic)
+            for (size_t r = 0; r < num_ranges; r++) {
+                range_rows[r + 1] = internal::countASCIIRows(file.data() + bounds[r], file.data() + bounds[r + 1]);
+            }
+            for (size_t r = 0; r < num_ranges; r++) range_rows[r + 1] += range_rows[r];
 
-            // Construct matrix
-            size_t n_cols = v.size()/n_rows;
+            size_t n_rows = range_rows[num_ranges];
+            size_t n_cols = (n_rows > 0) ? internal::countASCIIFirstRowValues(file.data(), file.data() + file.size()) : 0;
             matrix.resize(n_rows, n_cols);
-            for (size_t i = 0; i < n_rows; i++) {
-                for (size_t j = 0; j < n_cols; j++) {
-                    matrix(i,j) = v[i * n_cols + j];
+
+            // Parse ranges concurrently, each straight into its own block of rows
+            bool success = true;
+#pragma omp parallel for schedule(dynamic) reduction(&&: success)
+            for (size_t r = 0; r < num_ranges; r++) {
+                const char * ptr = file.data() + bounds[r];
+                const char * end = file.data() + bounds[r + 1];
+                size_t i = range_rows[r];
+                bool range_success = true;
+                while (range_success && internal::skipToASCIIRow(ptr, end)) {
+                    for (size_t j = 0; j < n_cols; j++) {
+                        typename Matrix::Scalar val;
+                        if (!internal::parseASCIIValue(ptr, end, val)) {
+                            range_success = false;
+                            break;
+                        }
+                        matrix(i,j) = val;
+                    }
+                    // Anything but separators left on the row means inconsistent column counts
+                    if (range_success && !internal::finishASCIIRow(ptr, end)) range_success = false;
+                    i++;
                 }
+                success = range_success && success;
             }
+
+            if (!success) matrix.resize(0, 0);
         }
     }
 
@@ -63,6 +198,47 @@ namespace cilantro {
         }
     }
 
+    // Zero-copy view of a binary matrix file written by writeEigenMatrixToFile; the matrix data is read straight from the
+    // (shared) page cache and stays valid for the lifetime of this object. Invalid files yield an empty map.
+    template <typename ScalarT, ptrdiff_t EigenDim>
+    class MemoryMappedDataMatrix {
+    public:
+        MemoryMappedDataMatrix(const std::string &file_name)
+                : file_(file_name),
+                  map_(get_mapped_data_(file_))
+        {}
+
+        inline bool isValid() const { return map_.data() != NULL; }
+
+        inline const ConstDataMatrixMap<ScalarT,EigenDim>& getMap() const { return map_; }
+
+        inline const MemoryMappedFile& getFile() const { return file_; }
+
+    private:
+        MemoryMappedFile file_;
+        ConstDataMatrixMap<ScalarT,EigenDim> map_;
+
+        static Eigen::Map<const Eigen::Matrix<ScalarT,EigenDim,Eigen::Dynamic>> get_mapped_data_(MemoryMappedFile &file) {
+            typedef typename Eigen::Matrix<ScalarT,EigenDim,Eigen::Dynamic>::Index Index;
+            const size_t header_size = 2*sizeof(Index);
+            const Index empty_rows = (EigenDim == Eigen::Dynamic) ? 0 : EigenDim;
+
+            Index rows = 0, cols = 0;
+            if (file.isOpen() && file.size() >= header_size) {
+                std::memcpy(&rows, file.data(), sizeof(Index));
+                std::memcpy(&cols, file.data() + sizeof(Index), sizeof(Index));
+            }
+            if (rows < 0 || cols < 0 || (EigenDim != Eigen::Dynamic && rows != EigenDim) ||
+                file.size() < header_size || (file.size() - header_size)/sizeof(ScalarT) < (size_t)rows*(size_t)cols)
+            {
+                file.close();
+                return Eigen::Map<const Eigen::Matrix<ScalarT,EigenDim,Eigen::Dynamic>>(NULL, empty_rows, 0);
+            }
+
+            return Eigen::Map<const Eigen::Matrix<ScalarT,EigenDim,Eigen::Dynamic>>((const ScalarT *)(file.data() + header_size), rows, cols);
+        }
+    };
+
     template<typename ScalarT>
     void readVectorFromFile(const std::string &file_name, std::vector<ScalarT> &vec, bool binary = true) {
         Eigen::Matrix<ScalarT, Eigen::Dynamic, 1> vec_e;
@@ -91,9 +91,28 @@ namespace cilantro {
             distances.resize(num_results);
         }
 
+        // Writes to caller-provided buffers of (at least) k entries and returns the number of neighbors found; avoids
+        // per query allocations in batched searches
+        inline size_t kNNSearch(const Eigen::Ref<const Eigen::Matrix<ScalarT,EigenDim,1>> &query_pt, size_t k, size_t *neighbors, ScalarT *distances) const {
+            return kd_tree_.knnSearch(query_pt.data(), k, neighbors, distances);
+        }
+
+        // Number of points within radius (in the same units as for radiusSearch), counting up to max_count
+        size_t radiusCount(const Eigen::Ref<const Eigen::Matrix<ScalarT,EigenDim,1>> &query_pt, ScalarT radius, size_t max_count = std::numeric_limits<size_t>::max()) const {
+            RadiusCounter_ counter(radius, max_count);
+            if (max_count > 0) kd_tree_.findNeighbors(counter, query_pt.data(), params_);
+            return counter.count;
+        }
+
+        // Feeds every point closer than result_set.worstDist() to result_set.addPoint(dist, index) (see nanoflann's result
+        // sets), stopping early if the latter returns false
+        template <class ResultSetT>
+        inline void findNeighbors(const Eigen::Ref<const Eigen::Matrix<ScalarT,EigenDim,1>> &query_pt, ResultSetT &result_set) const {
+            kd_tree_.findNeighbors(result_set, query_pt.data(), params_);
+        }
+
         void radiusSearch(const Eigen::Ref<const Eigen::Matrix<ScalarT,EigenDim,1>> &query_pt, ScalarT radius, std::vector<size_t> &neighbors, std::vector<ScalarT> &distances) const {
             std::vector<std::pair<size_t,ScalarT>> matches;
-            matches.reserve(data_map_.cols());
             size_t num_results = kd_tree_.radiusSearch(query_pt.data(), radius, matches, params_);
             neighbors.resize(num_results);
             distances.resize(num_results);
@@ -131,6 +150,22 @@ namespace cilantro {
         }
 
     private:
+        // nanoflann result set that only counts
+        struct RadiusCounter_ {
+            inline RadiusCounter_(ScalarT radius, size_t max_count) : radius(radius), maxCount(max_count), count(0) {}
+
+            inline bool addPoint(ScalarT dist, size_t) {
+                if (dist < radius) count++;
+                return count < maxCount;
+            }
+            inline ScalarT worstDist() const { return radius; }
+            inline bool full() const { return true; }
+
+            ScalarT radius;
+            size_t maxCount;
+            size_t count;
+        };
+
         typedef nanoflann::KDTreeSingleIndexAdaptor<DistAdaptor<KDTreeDataAdaptors::EigenMap<ScalarT,EigenDim>>, KDTreeDataAdaptors::EigenMap<ScalarT,EigenDim>, EigenDim> TreeType_;
 
         ConstDataMatrixMap<ScalarT,EigenDim> data_map_;
@@ -4,42 +4,66 @@
 #include <cilantro/kd_tree.hpp>
 
 namespace cilantro {
+    template <typename ScalarT, ptrdiff_t EigenDim, template <class> class DistAdaptor>
+    class StreamingKMeans;
+
     template <typename ScalarT, ptrdiff_t EigenDim, template <class> class DistAdaptor = KDTreeDistanceAdaptors::L2>
     class KMeans {
     public:
         EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
+        enum struct InitializationMethod {RANDOM, KMEANS_PLUS_PLUS, KMEANS_PARALLEL};
+        // HAMERLY keeps per-point distance bounds to skip most distance computations (requires a metric that
+        // satisfies the triangle inequality)
+        enum struct AssignmentMethod {BRUTE_FORCE, KD_TREE, HAMERLY};
+
         KMeans(const ConstDataMatrixMap<ScalarT,EigenDim> &data)
                 : data_map_(data),
+                  init_method_(InitializationMethod::KMEANS_PLUS_PLUS),
+                  random_seed_(std::random_device()()),
+                  oversampling_factor_(2.0),
+                  num_rounds_(5),
                   iteration_count_(0)
         {}
 
         ~KMeans() {}
 
-        KMeans& cluster(const ConstDataMatrixMap<ScalarT,EigenDim> &centroids, size_t max_iter = 100, ScalarT tol = std::numeric_limits<ScalarT>::epsilon(), bool use_kd_tree = false) {
+        inline InitializationMethod getInitializationMethod() const { return init_method_; }
+        inline KMeans& setInitializationMethod(const InitializationMethod &method) { init_method_ = method; return *this; }
+
+        inline size_t getRandomSeed() const { return random_seed_; }
+        inline KMeans& setRandomSeed(size_t seed) { random_seed_ = seed; return *this; }
+
+        // k-means|| samples (oversampling_factor*num_clusters) candidates per round in expectation
+        inline ScalarT getKMeansParallelOversamplingFactor() const { return oversampling_factor_; }
+        inline KMeans& setKMeansParallelOversamplingFactor(ScalarT factor) { oversampling_factor_ = factor; return *this; }
+
+        inline size_t getKMeansParallelNumberOfRounds() const { return num_rounds_; }
+        inline KMeans& setKMeansParallelNumberOfRounds(size_t num_rounds) { num_rounds_ = num_rounds; return *this; }
+
+        KMeans& cluster(const ConstDataMatrixMap<ScalarT,EigenDim> &centroids, size_t max_iter = 100, ScalarT tol = std::numeric_limits<ScalarT>::epsilon(), const AssignmentMethod &assignment_method = AssignmentMethod::BRUTE_FORCE) {
             cluster_centroids_ = centroids;
-            cluster_(max_iter, tol, use_kd_tree);
+            cluster_(max_iter, tol, assignment_method);
             return *this;
         }
 
-        KMeans& cluster(size_t num_clusters, size_t max_iter = 100, ScalarT tol = std::numeric_limits<ScalarT>::epsilon(), bool use_kd_tree = false) {
-            cluster_centroids_.resize(data_map_.rows(), (num_clusters > data_map_.cols()) ? data_map_.cols() : num_clusters);
-
-            std::vector<size_t> range(data_map_.cols());
-            for (size_t i = 0; i < range.size(); i++) range[i] = i;
+        KMeans& cluster(size_t num_clusters, size_t max_iter = 100, ScalarT tol = std::numeric_limits<ScalarT>::epsilon(), const AssignmentMethod &assignment_method = AssignmentMethod::BRUTE_FORCE) {
+            initialize_centroids_(num_clusters);
+            cluster_(max_iter, tol, assignment_method);
+            return *this;
+        }
 
-            std::random_device rd;
-            std::mt19937 rng(rd());
-            std::uniform_int_distribution<size_t> dist;
-            size_t prev_size = range.size();
-            for (size_t i = 0; i < cluster_centroids_.cols(); i++) {
-                size_t rand_ind = dist(rng) % prev_size;
-                cluster_centroids_.col(i) = data_map_.col(range[rand_ind]);
-                prev_size--;
-                std::swap(range[rand_ind], range[prev_size]);
-            }
+        // Mini-batch k-means (Sculley): each iteration updates the centroids from batch_size randomly drawn points,
+        // followed by a single full assignment pass; max_iter counts batches
+        KMeans& clusterMiniBatch(const ConstDataMatrixMap<ScalarT,EigenDim> &centroids, size_t batch_size, size_t max_iter = 100, ScalarT tol = std::numeric_limits<ScalarT>::epsilon(), const AssignmentMethod &assignment_method = AssignmentMethod::BRUTE_FORCE) {
+            cluster_centroids_ = centroids;
+            cluster_mini_batch_(batch_size, max_iter, tol, assignment_method);
+            return *this;
+        }
 
-            cluster_(max_iter, tol, use_kd_tree);
+        KMeans& clusterMiniBatch(size_t num_clusters, size_t batch_size, size_t max_iter = 100, ScalarT tol = std::numeric_limits<ScalarT>::epsilon(), const AssignmentMethod &assignment_method = AssignmentMethod::BRUTE_FORCE) {
+            initialize_centroids_(num_clusters);
+            cluster_mini_batch_(batch_size, max_iter, tol, assignment_method);
             return *this;
         }
 
@@ -54,15 +78,376 @@ namespace cilantro {
         inline size_t getPerformedIterationsCount() const { return iteration_count_; }
 
     private:
+        friend class StreamingKMeans<ScalarT,EigenDim,DistAdaptor>;
+
         ConstDataMatrixMap<ScalarT,EigenDim> data_map_;
 
         Eigen::Matrix<ScalarT,EigenDim,Eigen::Dynamic> cluster_centroids_;
         std::vector<std::vector<size_t>> cluster_point_indices_;
         std::vector<size_t> cluster_index_map_;
 
+        InitializationMethod init_method_;
+        size_t random_seed_;
+        ScalarT oversampling_factor_;
+        size_t num_rounds_;
+
         size_t iteration_count_;
 
-        void cluster_(size_t max_iter, ScalarT tol, bool use_kd_tree) {
+        typedef KDTreeDataAdaptors::EigenMap<ScalarT,EigenDim> DataAdaptorType_;
+        typedef DistAdaptor<DataAdaptorType_> DistAdaptorType_;
+
+        // Points per work unit in seeding; fixed so that results do not depend on the number of threads
+        static const size_t seeding_chunk_size_ = 4096;
+
+        // Resolved at compile time
+        static inline bool is_l2_metric_() {
+            return std::is_same<DistAdaptorType_, KDTreeDistanceAdaptors::L2<DataAdaptorType_>>::value ||
+                   std::is_same<DistAdaptorType_, KDTreeDistanceAdaptors::L2Simple<DataAdaptorType_>>::value;
+        }
+
+        // Metric value as used for assignments (squared distance for L2)
+        static inline ScalarT point_distance_(const DistAdaptorType_ &dist_adaptor, const ConstDataMatrixMap<ScalarT,EigenDim> &data, const ScalarT * centroid, size_t ind) {
+            if (is_l2_metric_()) {
+                return (Eigen::Map<const Eigen::Matrix<ScalarT,EigenDim,1>>(centroid, data.rows()) - data.col(ind)).squaredNorm();
+            } else {
+                return dist_adaptor.evalMetric(centroid, ind, data.rows());
+            }
+        }
+
+        // Actual distance from a point_distance_ value
+        static inline ScalarT metric_distance_(ScalarT value) {
+            return (is_l2_metric_()) ? std::sqrt(value) : value;
+        }
+
+        // Tile sizes (points x centroids) for the blocked L2 assignment kernel
+        static const size_t point_block_size_ = 256;
+        static const size_t centroid_block_size_ = 512;
+
+        // Blocked nearest centroid search for L2 metrics. Squared distances are expanded as
+        // ||x||^2 - 2*x.c + ||c||^2, with the cross terms of each tile computed by a single matrix product and the
+        // argmin fused into the tile loop. Coordinates are shifted by the centroid mean first, to limit cancellation.
+        // The expansion can still misorder near ties, so points whose two best candidates are within its rounding
+        // error bound are searched again with exact distances (ties go to the lower index); assignments then agree
+        // with the direct search. Writes squared distances to nearest/second nearest centroids if the respective
+        // pointers are not NULL. Returns true if any entry of nearest_ind changed.
+        static bool find_nearest_centroids_l2_(const ConstDataMatrixMap<ScalarT,EigenDim> &data,
+                                               const Eigen::Matrix<ScalarT,EigenDim,Eigen::Dynamic> &centroids,
+                                               std::vector<size_t> &nearest_ind,
+                                               std::vector<ScalarT> *nearest_dist = NULL,
+                                               std::vector<ScalarT> *second_dist = NULL)
+        {
+            size_t num_points = data.cols();
+            size_t num_clusters = centroids.cols();
+            if (num_points == 0 || num_clusters == 0) return false;
+
+            Eigen::Matrix<ScalarT,EigenDim,1> offset(centroids.rowwise().mean());
+            Eigen::Matrix<ScalarT,EigenDim,Eigen::Dynamic> centroids_shifted(centroids.colwise() - offset);
+            Eigen::Matrix<ScalarT,Eigen::Dynamic,1> centroid_norms(centroids_shifted.colwise().squaredNorm().transpose());
+            // Cross terms come out of the product already scaled by -2
+            centroids_shifted *= ScalarT(-2.0);
+            // Rounding error of the expanded distances relative to ||x||^2 + max||c||^2 (which bounds 2*|x.c|)
+            const ScalarT max_centroid_norm = centroid_norms.maxCoeff();
+            const ScalarT tie_tol = 4*(data.rows() + 2)*std::numeric_limits<ScalarT>::epsilon();
+
+            const size_t point_block_size = point_block_size_;
+            const size_t centroid_block_size = centroid_block_size_;
+            size_t num_blocks = (num_points - 1)/point_block_size + 1;
+            bool changed = false;
+
+#pragma omp parallel shared (changed)
+            {
+                Eigen::Matrix<ScalarT,EigenDim,Eigen::Dynamic> tile(data.rows(), point_block_size);
+                Eigen::Matrix<ScalarT,Eigen::Dynamic,Eigen::Dynamic> cross(point_block_size, centroid_block_size);
+                std::vector<ScalarT> best(point_block_size), second(point_block_size);
+                std::vector<size_t> best_ind(point_block_size);
+                bool changed_local = false;
+
+#pragma omp for schedule (dynamic)
+                for (size_t b = 0; b < num_blocks; b++) {
+                    size_t start = b*point_block_size;
+                    size_t len = std::min(point_block_size, num_points - start);
+
+                    tile.leftCols(len) = data.middleCols(start, len).colwise() - offset;
+                    std::fill(best.begin(), best.begin() + len, std::numeric_limits<ScalarT>::infinity());
+                    std::fill(second.begin(), second.begin() + len, std::numeric_limits<ScalarT>::infinity());
+
+                    for (size_t cb = 0; cb < num_clusters; cb += centroid_block_size) {
+                        size_t clen = std::min(centroid_block_size, num_clusters - cb);
+                        cross.topLeftCorner(len, clen).noalias() = tile.leftCols(len).transpose()*centroids_shifted.middleCols(cb, clen);
+                        // Point-contiguous, branchless updates so that the compiler can vectorize across points
+                        for (size_t c = 0; c < clen; c++) {
+                            const ScalarT * cross_col = cross.col(c).data();
+                            const ScalarT norm = centroid_norms[cb + c];
+                            const size_t ind = cb + c;
+                            for (size_t p = 0; p < len; p++) {
+                                // Omits ||x||^2, which is constant per point
+                                ScalarT dist = norm + cross_col[p];
+                                ScalarT best_p = best[p];
+                                bool closer = dist < best_p;
+                                second[p] = (closer) ? best_p : std::min(dist, second[p]);
+                                best[p] = (closer) ? dist : best_p;
+                                best_ind[p] = (closer) ? ind : best_ind[p];
+                            }
+                        }
+                    }
+
+                    for (size_t p = 0; p < len; p++) {
+                        ScalarT point_norm = tile.col(p).squaredNorm();
+                        ScalarT error_bound = tie_tol*(point_norm + max_centroid_norm);
+                        if (second[p] - best[p] <= error_bound) {
+                            // Near tie: exact search, evaluated as in point_distance_
+                            best[p] = std::numeric_limits<ScalarT>::infinity();
+                            second[p] = std::numeric_limits<ScalarT>::infinity();
+                            for (size_t j = 0; j < num_clusters; j++) {
+                                ScalarT dist = (centroids.col(j) - data.col(start + p)).squaredNorm();
+                                if (dist < best[p]) {
+                                    second[p] = best[p];
+                                    best[p] = dist;
+                                    best_ind[p] = j;
+                                } else if (dist < second[p]) {
+                                    second[p] = dist;
+                                }
+                            }
+                        } else {
+                            // The second distance bounds all others from below, so it is rounded down
+                            best[p] = std::max<ScalarT>(best[p] + point_norm, 0.0);
+                            second[p] = std::max<ScalarT>(second[p] + point_norm - error_bound, 0.0);
+                        }
+                        if (nearest_ind[start + p] != best_ind[p]) {
+                            nearest_ind[start + p] = best_ind[p];
+                            changed_local = true;
+                        }
+                        if (nearest_dist != NULL) (*nearest_dist)[start + p] = best[p];
+                        if (second_dist != NULL) (*second_dist)[start + p] = second[p];
+                    }
+                }
+
+                if (changed_local) {
+#pragma omp critical
+                    changed = true;
+                }
+            }
+
+            return changed;
+        }
+
+        // Nearest and second nearest centroids of a point, as metric distances
+        inline void find_two_nearest_centroids_(const DistAdaptorType_ &dist_adaptor, size_t ind, size_t &nearest_ind, ScalarT &nearest_dist, ScalarT &second_dist) const {
+            nearest_ind = 0;
+            nearest_dist = std::numeric_limits<ScalarT>::infinity();
+            second_dist = std::numeric_limits<ScalarT>::infinity();
+            for (size_t j = 0; j < cluster_centroids_.cols(); j++) {
+                ScalarT dist = point_distance_(dist_adaptor, data_map_, cluster_centroids_.col(j).data(), ind);
+                if (dist < nearest_dist) {
+                    second_dist = nearest_dist;
+                    nearest_dist = dist;
+                    nearest_ind = j;
+                } else if (dist < second_dist) {
+                    second_dist = dist;
+                }
+            }
+            nearest_dist = metric_distance_(nearest_dist);
+            second_dist = metric_distance_(second_dist);
+        }
+
+        void initialize_centroids_(size_t num_clusters) {
+            if (num_clusters > data_map_.cols()) num_clusters = data_map_.cols();
+
+            std::mt19937 rng(random_seed_);
+            switch (init_method_) {
+                case InitializationMethod::RANDOM:
+                    initialize_random_(num_clusters, rng);
+                    break;
+                case InitializationMethod::KMEANS_PLUS_PLUS:
+                    initialize_kmeans_plus_plus_(data_map_, std::vector<ScalarT>(), num_clusters, rng, cluster_centroids_);
+                    break;
+                case InitializationMethod::KMEANS_PARALLEL:
+                    initialize_kmeans_parallel_(num_clusters, rng);
+                    break;
+            }
+        }
+
+        void initialize_random_(size_t num_clusters, std::mt19937 &rng) {
+            cluster_centroids_.resize(data_map_.rows(), num_clusters);
+
+            std::vector<size_t> range(data_map_.cols());
+            for (size_t i = 0; i < range.size(); i++) range[i] = i;
+
+            std::uniform_int_distribution<size_t> dist;
+            size_t prev_size = range.size();
+            for (size_t i = 0; i < cluster_centroids_.cols(); i++) {
+                size_t rand_ind = dist(rng) % prev_size;
+                cluster_centroids_.col(i) = data_map_.col(range[rand_ind]);
+                prev_size--;
+                std::swap(range[rand_ind], range[prev_size]);
+            }
+        }
+
+        // Lowers min_dist (and updates nearest, if not empty) against centers.col(first..last-1), in parallel over
+        // fixed size chunks; chunk_sums receives the (weighted) sum of min_dist per chunk
+        static void update_min_distances_(const ConstDataMatrixMap<ScalarT,EigenDim> &data,
+                                          const std::vector<ScalarT> &weights,
+                                          const Eigen::Matrix<ScalarT,EigenDim,Eigen::Dynamic> &centers,
+                                          size_t first, size_t last,
+                                          std::vector<ScalarT> &min_dist,
+                                          std::vector<size_t> &nearest,
+                                          std::vector<ScalarT> &chunk_sums)
+        {
+            DataAdaptorType_ data_adaptor(data);
+            DistAdaptorType_ dist_adaptor(data_adaptor);
+
+            size_t num_points = data.cols();
+            size_t num_chunks = chunk_sums.size();
+            bool track_nearest = !nearest.empty();
+            bool weighted = !weights.empty();
+
+#pragma omp parallel for shared (min_dist, nearest, chunk_sums)
+            for (size_t k = 0; k < num_chunks; k++) {
+                size_t end = std::min((k+1)*seeding_chunk_size_, num_points);
+                ScalarT sum = 0.0;
+                for (size_t i = k*seeding_chunk_size_; i < end; i++) {
+                    for (size_t j = first; j < last; j++) {
+                        ScalarT dist = point_distance_(dist_adaptor, data, centers.col(j).data(), i);
+                        if (dist < min_dist[i]) {
+                            min_dist[i] = dist;
+                            if (track_nearest) nearest[i] = j;
+                        }
+                    }
+                    sum += (weighted) ? weights[i]*min_dist[i] : min_dist[i];
+                }
+                chunk_sums[k] = sum;
+            }
+        }
+
+        // Draws an index with probability proportional to (weighted) min_dist
+        static size_t sample_weighted_index_(const std::vector<ScalarT> &weights,
+                                             const std::vector<ScalarT> &min_dist,
+                                             const std::vector<ScalarT> &chunk_sums,
+                                             std::mt19937 &rng)
+        {
+            size_t num_points = min_dist.size();
+            ScalarT total = 0.0;
+            for (size_t k = 0; k < chunk_sums.size(); k++) total += chunk_sums[k];
+
+            // All remaining points coincide with already selected ones
+            if (!(total > 0.0)) return std::uniform_int_distribution<size_t>(0, num_points - 1)(rng);
+
+            ScalarT r = std::uniform_real_distribution<ScalarT>(0.0, total)(rng);
+            size_t k = 0;
+            while (k < chunk_sums.size() - 1 && r >= chunk_sums[k]) {
+                r -= chunk_sums[k];
+                k++;
+            }
+
+            bool weighted = !weights.empty();
+            size_t end = std::min((k+1)*seeding_chunk_size_, num_points);
+            size_t ind = k*seeding_chunk_size_;
+            while (ind < end - 1) {
+                ScalarT w = (weighted) ? weights[ind]*min_dist[ind] : min_dist[ind];
+                if (r < w) break;
+                r -= w;
+                ind++;
+            }
+            return ind;
+        }
+
+        // k-means++ (D^2 sampling) over a (possibly weighted) point set
+        static void initialize_kmeans_plus_plus_(const ConstDataMatrixMap<ScalarT,EigenDim> &data,
+                                                 const std::vector<ScalarT> &weights,
+                                                 size_t num_clusters,
+                                                 std::mt19937 &rng,
+                                                 Eigen::Matrix<ScalarT,EigenDim,Eigen::Dynamic> &centroids)
+        {
+            size_t num_points = data.cols();
+            centroids.resize(data.rows(), num_clusters);
+            if (num_clusters == 0) return;
+
+            std::vector<ScalarT> min_dist(num_points, std::numeric_limits<ScalarT>::infinity());
+            std::vector<size_t> nearest;
+            std::vector<ScalarT> chunk_sums((num_points - 1)/seeding_chunk_size_ + 1);
+
+            size_t ind = std::uniform_int_distribution<size_t>(0, num_points - 1)(rng);
+            for (size_t c = 0; c < num_clusters; c++) {
+                centroids.col(c) = data.col(ind);
+                if (c == num_clusters - 1) break;
+                update_min_distances_(data, weights, centroids, c, c + 1, min_dist, nearest, chunk_sums);
+                ind = sample_weighted_index_(weights, min_dist, chunk_sums, rng);
+            }
+        }
+
+        // k-means|| (Bahmani et al.): a few rounds of independent oversampling, followed by weighted k-means++
+        // reclustering of the candidate set
+        void initialize_kmeans_parallel_(size_t num_clusters, std::mt19937 &rng) {
+            size_t num_points = data_map_.cols();
+            if (num_clusters == 0) {
+                cluster_centroids_.resize(data_map_.rows(), 0);
+                return;
+            }
+
+            std::vector<ScalarT> no_weights;
+            std::vector<ScalarT> min_dist(num_points, std::numeric_limits<ScalarT>::infinity());
+            std::vector<size_t> nearest(num_points, 0);
+            size_t num_chunks = (num_points - 1)/seeding_chunk_size_ + 1;
+            std::vector<ScalarT> chunk_sums(num_chunks);
+
+            Eigen::Matrix<ScalarT,EigenDim,Eigen::Dynamic> candidates(data_map_.rows(), 1);
+            candidates.col(0) = data_map_.col(std::uniform_int_distribution<size_t>(0, num_points - 1)(rng));
+            update_min_distances_(data_map_, no_weights, candidates, 0, 1, min_dist, nearest, chunk_sums);
+
+            ScalarT oversampling = oversampling_factor_*num_clusters;
+            std::vector<std::vector<size_t>> chunk_samples(num_chunks);
+            for (size_t r = 0; r < num_rounds_; r++) {
+                ScalarT total = 0.0;
+                for (size_t k = 0; k < num_chunks; k++) total += chunk_sums[k];
+                if (!(total > 0.0)) break;
+
+                // Each chunk gets its own generator, seeded from the master one
+                uint32_t round_seed = (uint32_t)rng();
+#pragma omp parallel for shared (chunk_samples)
+                for (size_t k = 0; k < num_chunks; k++) {
+                    std::seed_seq seq{round_seed, (uint32_t)k};
+                    std::mt19937 chunk_rng(seq);
+                    std::uniform_real_distribution<ScalarT> unif(0.0, 1.0);
+                    size_t end = std::min((k+1)*seeding_chunk_size_, num_points);
+                    chunk_samples[k].clear();
+                    for (size_t i = k*seeding_chunk_size_; i < end; i++) {
+                        if (unif(chunk_rng)*total < oversampling*min_dist[i]) chunk_samples[k].emplace_back(i);
+                    }
+                }
+
+                size_t prev_size = candidates.cols();
+                size_t num_new = 0;
+                for (size_t k = 0; k < num_chunks; k++) num_new += chunk_samples[k].size();
+                if (num_new == 0) continue;
+
+                candidates.conservativeResize(Eigen::NoChange, prev_size + num_new);
+                size_t pos = prev_size;
+                for (size_t k = 0; k < num_chunks; k++) {
+                    for (size_t i = 0; i < chunk_samples[k].size(); i++) {
+                        candidates.col(pos++) = data_map_.col(chunk_samples[k][i]);
+                    }
+                }
+                update_min_distances_(data_map_, no_weights, candidates, prev_size, candidates.cols(), min_dist, nearest, chunk_sums);
+            }
+
+            if (candidates.cols() <= num_clusters) {
+                // Not enough candidates; fill in with k-means++ over the full data
+                Eigen::Matrix<ScalarT,EigenDim,Eigen::Dynamic> extra;
+                initialize_kmeans_plus_plus_(data_map_, no_weights, num_clusters - candidates.cols(), rng, extra);
+                cluster_centroids_.resize(data_map_.rows(), num_clusters);
+                cluster_centroids_.leftCols(candidates.cols()) = candidates;
+                cluster_centroids_.rightCols(extra.cols()) = extra;
+                return;
+            }
+
+            // Weight candidates by the number of points they attract
+            std::vector<ScalarT> weights(candidates.cols(), 0.0);
+            for (size_t i = 0; i < num_points; i++) weights[nearest[i]] += 1.0;
+
+            initialize_kmeans_plus_plus_(candidates, weights, num_clusters, rng, cluster_centroids_);
+        }
+
+        void cluster_(size_t max_iter, ScalarT tol, const AssignmentMethod &assignment_method) {
             size_t num_clusters = cluster_centroids_.cols();
             size_t num_points = data_map_.cols();
             ScalarT tol_sq = tol*tol;
@@ -77,15 +462,71 @@ namespace cilantro {
 
             Eigen::Matrix<ScalarT,EigenDim,Eigen::Dynamic> centroids_old;
 
-            KDTreeDataAdaptors::EigenMap<ScalarT,EigenDim> data_adaptor(data_map_);
-            DistAdaptor<KDTreeDataAdaptors::EigenMap<ScalarT,EigenDim>> dist_adaptor(data_adaptor);
+            DataAdaptorType_ data_adaptor(data_map_);
+            DistAdaptorType_ dist_adaptor(data_adaptor);
+
+            // Hamerly bounds: distance to assigned centroid (upper) and to all other centroids (lower)
+            bool use_bounds = assignment_method == AssignmentMethod::HAMERLY;
+            std::vector<ScalarT> upper_bounds, lower_bounds, half_separation, drift;
+            std::vector<size_t> reassigned;
+            ConstDataMatrixMap<ScalarT,EigenDim> centroids_map(cluster_centroids_);
+            DataAdaptorType_ centroids_data_adaptor(centroids_map);
+            DistAdaptorType_ centroids_dist_adaptor(centroids_data_adaptor);
+            if (use_bounds) {
+                upper_bounds.resize(num_points);
+                lower_bounds.resize(num_points);
+                half_separation.resize(num_clusters);
+                drift.resize(num_clusters);
+            }
 
             iteration_count_ = 0;
             while (iteration_count_ < max_iter) {
                 bool assignments_unchanged = true;
 
                 // Update assignments
-                if (use_kd_tree) {
+                if (use_bounds && iteration_count_ == 0 && is_l2_metric_()) {
+                    if (find_nearest_centroids_l2_(data_map_, cluster_centroids_, cluster_index_map_, &upper_bounds, &lower_bounds)) assignments_unchanged = false;
+#pragma omp parallel for shared (upper_bounds, lower_bounds)
+                    for (size_t i = 0; i < num_points; i++) {
+                        upper_bounds[i] = metric_distance_(upper_bounds[i]);
+                        lower_bounds[i] = metric_distance_(lower_bounds[i]);
+                    }
+                } else if (use_bounds && iteration_count_ == 0) {
+#pragma omp parallel for shared (assignments_unchanged) private (extr_dist_ind)
+                    for (size_t i = 0; i < num_points; i++) {
+                        find_two_nearest_centroids_(dist_adaptor, i, extr_dist_ind, upper_bounds[i], lower_bounds[i]);
+                        if (cluster_index_map_[i] != extr_dist_ind) assignments_unchanged = false;
+                        cluster_index_map_[i] = extr_dist_ind;
+                    }
+                } else if (use_bounds) {
+                    // Half distance from each centroid to its closest other centroid
+#pragma omp parallel for shared (half_separation) private (extr_dist, dist)
+                    for (size_t j = 0; j < num_clusters; j++) {
+                        extr_dist = std::numeric_limits<ScalarT>::infinity();
+                        for (size_t l = 0; l < num_clusters; l++) {
+                            if (l == j) continue;
+                            dist = point_distance_(centroids_dist_adaptor, centroids_map, cluster_centroids_.col(j).data(), l);
+                            if (dist < extr_dist) extr_dist = dist;
+                        }
+                        half_separation[j] = 0.5*metric_distance_(extr_dist);
+                    }
+
+#pragma omp parallel for shared (assignments_unchanged) private (extr_dist_ind)
+                    for (size_t i = 0; i < num_points; i++) {
+                        size_t curr_ind = cluster_index_map_[i];
+                        ScalarT bound = std::max(half_separation[curr_ind], lower_bounds[i]);
+                        if (upper_bounds[i] <= bound) continue;
+                        // Tighten upper bound and retest
+                        upper_bounds[i] = metric_distance_(point_distance_(dist_adaptor, data_map_, cluster_centroids_.col(curr_ind).data(), i));
+                        if (upper_bounds[i] <= bound) continue;
+
+                        find_two_nearest_centroids_(dist_adaptor, i, extr_dist_ind, upper_bounds[i], lower_bounds[i]);
+                        if (curr_ind != extr_dist_ind) {
+                            assignments_unchanged = false;
+                            cluster_index_map_[i] = extr_dist_ind;
+                        }
+                    }
+                } else if (assignment_method == AssignmentMethod::KD_TREE) {
                     std::vector<size_t> neighbors;
                     std::vector<ScalarT> distances;
                     KDTree<ScalarT,EigenDim,DistAdaptor> tree(cluster_centroids_);
@@ -95,19 +536,14 @@ namespace cilantro {
                         if (cluster_index_map_[i] != neighbors[0]) assignments_unchanged = false;
                         cluster_index_map_[i] = neighbors[0];
                     }
+                } else if (is_l2_metric_()) {
+                    if (find_nearest_centroids_l2_(data_map_, cluster_centroids_, cluster_index_map_)) assignments_unchanged = false;
                 } else {
 #pragma omp parallel for shared (assignments_unchanged) private (extr_dist, extr_dist_ind, dist)
                     for (size_t i = 0; i < num_points; i++) {
                         extr_dist = std::numeric_limits<ScalarT>::infinity();
                         for (size_t j = 0; j < num_clusters; j++) {
-                            // Resolved at compile time
-                            if (std::is_same<DistAdaptor<KDTreeDataAdaptors::EigenMap<ScalarT,EigenDim>>, KDTreeDistanceAdaptors::L2<KDTreeDataAdaptors::EigenMap<ScalarT,EigenDim>>>::value ||
-                                std::is_same<DistAdaptor<KDTreeDataAdaptors::EigenMap<ScalarT,EigenDim>>, KDTreeDistanceAdaptors::L2Simple<KDTreeDataAdaptors::EigenMap<ScalarT,EigenDim>>>::value)
-                            {
-                                dist = (cluster_centroids_.col(j) - data_map_.col(i)).squaredNorm();
-                            } else {
-                                dist = dist_adaptor.evalMetric(&(cluster_centroids_.col(j)[0]), i, data_map_.rows());
-                            }
+                            dist = point_distance_(dist_adaptor, data_map_, &(cluster_centroids_.col(j)[0]), i);
                             if (dist < extr_dist) {
                                 extr_dist = dist;
                                 extr_dist_ind = j;
@@ -119,14 +555,25 @@ namespace cilantro {
                 }
 
                 if (assignments_unchanged) break;
-                if (tol > 0.0) centroids_old = cluster_centroids_;
+                if (tol > 0.0 || use_bounds) centroids_old = cluster_centroids_;
 
-                // Update centroids
+                // Update centroids (per thread accumulators, reduced once per thread)
                 cluster_centroids_.setZero();
                 std::vector<size_t> point_count(num_clusters, 0);
-                for (size_t i = 0; i < num_points; i++) {
-                    cluster_centroids_.col(cluster_index_map_[i]) += data_map_.col(i);
-                    point_count[cluster_index_map_[i]]++;
+#pragma omp parallel
+                {
+                    Eigen::Matrix<ScalarT,EigenDim,Eigen::Dynamic> centroids_local(Eigen::Matrix<ScalarT,EigenDim,Eigen::Dynamic>::Zero(data_map_.rows(), num_clusters));
+                    std::vector<size_t> point_count_local(num_clusters, 0);
+#pragma omp for nowait
+                    for (size_t i = 0; i < num_points; i++) {
+                        centroids_local.col(cluster_index_map_[i]) += data_map_.col(i);
+                        point_count_local[cluster_index_map_[i]]++;
+                    }
+#pragma omp critical
+                    {
+                        cluster_centroids_ += centroids_local;
+                        for (size_t j = 0; j < num_clusters; j++) point_count[j] += point_count_local[j];
+                    }
                 }
 
                 // Handle empty clusters
@@ -143,28 +590,33 @@ namespace cilantro {
                     scale = 1.0/point_count[max_ind];
                     Eigen::Matrix<ScalarT,EigenDim,1> old_centroid(cluster_centroids_.col(max_ind)*scale);
                     extr_dist = -1.0;
-#pragma omp parallel for shared (extr_dist, extr_dist_ind) private (dist)
-                    for (size_t j = 0; j < num_points; j++) {
-                        if (cluster_index_map_[j] == max_ind) {
-                            // Resolved at compile time
-                            if (std::is_same<DistAdaptor<KDTreeDataAdaptors::EigenMap<ScalarT,EigenDim>>, KDTreeDistanceAdaptors::L2<KDTreeDataAdaptors::EigenMap<ScalarT,EigenDim>>>::value ||
-                                std::is_same<DistAdaptor<KDTreeDataAdaptors::EigenMap<ScalarT,EigenDim>>, KDTreeDistanceAdaptors::L2Simple<KDTreeDataAdaptors::EigenMap<ScalarT,EigenDim>>>::value)
-                            {
-                                dist = (old_centroid - data_map_.col(j)).squaredNorm();
-                            } else {
-                                dist = dist_adaptor.evalMetric(&(old_centroid[0]), j, data_map_.rows());
+                    extr_dist_ind = 0;
+#pragma omp parallel private (dist)
+                    {
+                        ScalarT extr_dist_local = -1.0;
+                        size_t extr_dist_ind_local = 0;
+#pragma omp for nowait
+                        for (size_t j = 0; j < num_points; j++) {
+                            if (cluster_index_map_[j] != max_ind) continue;
+                            dist = point_distance_(dist_adaptor, data_map_, &(old_centroid[0]), j);
+                            if (dist > extr_dist_local) {
+                                extr_dist_local = dist;
+                                extr_dist_ind_local = j;
                             }
+                        }
+                        // Ties go to the lowest index, independently of scheduling
 #pragma omp critical
-                            if (dist > extr_dist) {
-                                extr_dist = dist;
-                                extr_dist_ind = j;
-                            }
+                        if (extr_dist_local > extr_dist || (extr_dist_local == extr_dist && extr_dist_ind_local < extr_dist_ind)) {
+                            extr_dist = extr_dist_local;
+                            extr_dist_ind = extr_dist_ind_local;
                         }
                     }
 
                     // Move previously found point to current (empty) cluster
                     cluster_index_map_[extr_dist_ind] = i;
+                    if (use_bounds) reassigned.emplace_back(extr_dist_ind);
                     cluster_centroids_.col(max_ind) -= data_map_.col(extr_dist_ind);
+                    cluster_centroids_.col(i) += data_map_.col(extr_dist_ind);
                     point_count[max_ind]--;
                     point_count[i]++;
                 }
@@ -177,17 +629,241 @@ namespace cilantro {
 
                 iteration_count_++;
 
+                // Move bounds by centroid drifts
+                if (use_bounds) {
+                    size_t max_drift_ind = 0;
+                    ScalarT max_drift = 0.0, second_max_drift = 0.0;
+                    for (size_t j = 0; j < num_clusters; j++) {
+                        drift[j] = metric_distance_(point_distance_(centroids_dist_adaptor, centroids_map, centroids_old.col(j).data(), j));
+                        if (drift[j] > max_drift) {
+                            second_max_drift = max_drift;
+                            max_drift = drift[j];
+                            max_drift_ind = j;
+                        } else if (drift[j] > second_max_drift) {
+                            second_max_drift = drift[j];
+                        }
+                    }
+#pragma omp parallel for shared (upper_bounds, lower_bounds)
+                    for (size_t i = 0; i < num_points; i++) {
+                        upper_bounds[i] += drift[cluster_index_map_[i]];
+                        lower_bounds[i] -= (cluster_index_map_[i] == max_drift_ind) ? second_max_drift : max_drift;
+                    }
+                    // Points moved into empty clusters get trivial bounds
+                    for (size_t i = 0; i < reassigned.size(); i++) {
+                        upper_bounds[reassigned[i]] = std::numeric_limits<ScalarT>::infinity();
+                        lower_bounds[reassigned[i]] = 0.0;
+                    }
+                    reassigned.clear();
+                }
+
                 // Check for convergence of centroids
                 if (tol > 0.0 && (cluster_centroids_ - centroids_old).colwise().squaredNorm().maxCoeff() < tol_sq) break;
             }
 
-            cluster_point_indices_.resize(num_clusters);
-            for (size_t i = 0; i < num_points; i++) {
+            build_cluster_point_indices_();
+        }
+
+        void cluster_mini_batch_(size_t batch_size, size_t max_iter, ScalarT tol, const AssignmentMethod &assignment_method) {
+            size_t num_points = data_map_.cols();
+            ScalarT tol_sq = tol*tol;
+            if (batch_size > num_points) batch_size = num_points;
+
+            StreamingKMeans<ScalarT,EigenDim,DistAdaptor> streaming(cluster_centroids_);
+            streaming.setAssignmentMethod(assignment_method).setRandomSeed(random_seed_);
+
+            std::mt19937 rng(random_seed_);
+            std::uniform_int_distribution<size_t> dist(0, (num_points > 0) ? num_points - 1 : 0);
+            Eigen::Matrix<ScalarT,EigenDim,Eigen::Dynamic> batch(data_map_.rows(), batch_size);
+
+            iteration_count_ = 0;
+            while (iteration_count_ < max_iter && batch_size > 0) {
+                for (size_t i = 0; i < batch_size; i++) {
+                    batch.col(i) = data_map_.col(dist(rng));
+                }
+                streaming.addChunk(batch);
+                iteration_count_++;
+
+                ScalarT max_shift_sq = (streaming.getClusterCentroids() - cluster_centroids_).colwise().squaredNorm().maxCoeff();
+                cluster_centroids_ = streaming.getClusterCentroids();
+                if (tol > 0.0 && max_shift_sq < tol_sq) break;
+            }
+
+            cluster_index_map_ = streaming.getNearestClusterIndices(data_map_);
+            build_cluster_point_indices_();
+        }
+
+        void build_cluster_point_indices_() {
+            cluster_point_indices_.assign(cluster_centroids_.cols(), std::vector<size_t>());
+            for (size_t i = 0; i < cluster_index_map_.size(); i++) {
                 cluster_point_indices_[cluster_index_map_[i]].emplace_back(i);
             }
         }
     };
 
+    // Sequential k-means over a stream of data chunks, with bounded memory. Each chunk is assigned to the current
+    // centroids and every centroid c with weight n moves to (decay*n*c + chunk_sum)/(decay*n + chunk_count), i.e.
+    // with step size chunk_count/(decay*n + chunk_count). A decay factor of 1 yields the running mean of all points
+    // seen so far (the mini-batch k-means schedule); smaller values forget older chunks exponentially.
+    template <typename ScalarT, ptrdiff_t EigenDim, template <class> class DistAdaptor = KDTreeDistanceAdaptors::L2>
+    class StreamingKMeans {
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        typedef typename KMeans<ScalarT,EigenDim,DistAdaptor>::AssignmentMethod AssignmentMethod;
+
+        StreamingKMeans(const ConstDataMatrixMap<ScalarT,EigenDim> &centroids, ScalarT decay_factor = 1.0)
+                : num_clusters_(centroids.cols()),
+                  cluster_centroids_(centroids),
+                  cluster_weights_(centroids.cols(), 0.0),
+                  decay_factor_(decay_factor),
+                  assignment_method_(AssignmentMethod::BRUTE_FORCE),
+                  random_seed_(std::random_device()()),
+                  num_processed_points_(0)
+        {}
+
+        // Incoming points are buffered until num_clusters of them are available; the centroids are then initialized
+        // by (k-means++ seeded) k-means over the buffer
+        StreamingKMeans(size_t num_clusters, ScalarT decay_factor = 1.0)
+                : num_clusters_(num_clusters),
+                  decay_factor_(decay_factor),
+                  assignment_method_(AssignmentMethod::BRUTE_FORCE),
+                  random_seed_(std::random_device()()),
+                  num_processed_points_(0)
+        {}
+
+        ~StreamingKMeans() {}
+
+        inline ScalarT getDecayFactor() const { return decay_factor_; }
+        inline StreamingKMeans& setDecayFactor(ScalarT decay_factor) { decay_factor_ = decay_factor; return *this; }
+
+        // HAMERLY bounds do not carry over between chunks; it behaves as BRUTE_FORCE here
+        inline AssignmentMethod getAssignmentMethod() const { return assignment_method_; }
+        inline StreamingKMeans& setAssignmentMethod(const AssignmentMethod &method) { assignment_method_ = method; return *this; }
+
+        inline size_t getRandomSeed() const { return random_seed_; }
+        inline StreamingKMeans& setRandomSeed(size_t seed) { random_seed_ = seed; return *this; }
+
+        StreamingKMeans& addChunk(const ConstDataMatrixMap<ScalarT,EigenDim> &chunk) {
+            if (chunk.cols() == 0) return *this;
+
+            if (cluster_centroids_.cols() < num_clusters_) {
+                // Buffer until there are enough points to seed from
+                size_t prev_size = pending_points_.cols();
+                pending_points_.conservativeResize(chunk.rows(), prev_size + chunk.cols());
+                pending_points_.rightCols(chunk.cols()) = chunk;
+                if (pending_points_.cols() < num_clusters_) return *this;
+
+                // Full k-means on the buffered points gives the initial centroids and weights
+                KMeansType_ kmeans(pending_points_);
+                kmeans.setRandomSeed(random_seed_).cluster(num_clusters_, 100, std::numeric_limits<ScalarT>::epsilon(), assignment_method_);
+                cluster_centroids_ = kmeans.getClusterCentroids();
+                cluster_weights_.resize(num_clusters_);
+                for (size_t j = 0; j < num_clusters_; j++) {
+                    cluster_weights_[j] = kmeans.getClusterPointIndices()[j].size();
+                }
+                num_processed_points_ += pending_points_.cols();
+                pending_points_.resize(chunk.rows(), 0);
+                return *this;
+            }
+
+            update_(chunk);
+            return *this;
+        }
+
+        std::vector<size_t> getNearestClusterIndices(const ConstDataMatrixMap<ScalarT,EigenDim> &points) const {
+            std::vector<size_t> indices(points.cols());
+            if (cluster_centroids_.cols() == 0) return indices;
+
+            if (assignment_method_ == AssignmentMethod::KD_TREE) {
+                KDTree<ScalarT,EigenDim,DistAdaptor> tree(cluster_centroids_);
+                ScalarT dist;
+#pragma omp parallel for shared (indices) private (dist)
+                for (size_t i = 0; i < points.cols(); i++) {
+                    tree.nearestNeighborSearch(points.col(i), indices[i], dist);
+                }
+            } else if (KMeansType_::is_l2_metric_()) {
+                KMeansType_::find_nearest_centroids_l2_(points, cluster_centroids_, indices);
+            } else {
+                DataAdaptorType_ data_adaptor(points);
+                DistAdaptorType_ dist_adaptor(data_adaptor);
+#pragma omp parallel for shared (indices)
+                for (size_t i = 0; i < points.cols(); i++) {
+                    ScalarT min_dist = std::numeric_limits<ScalarT>::infinity();
+                    for (size_t j = 0; j < cluster_centroids_.cols(); j++) {
+                        ScalarT dist = KMeansType_::point_distance_(dist_adaptor, points, cluster_centroids_.col(j).data(), i);
+                        if (dist < min_dist) {
+                            min_dist = dist;
+                            indices[i] = j;
+                        }
+                    }
+                }
+            }
+
+            return indices;
+        }
+
+        inline const Eigen::Matrix<ScalarT,EigenDim,Eigen::Dynamic>& getClusterCentroids() const { return cluster_centroids_; }
+
+        // Effective (decayed) number of points represented by each centroid
+        inline const std::vector<ScalarT>& getClusterWeights() const { return cluster_weights_; }
+
+        inline size_t getNumberOfClusters() const { return cluster_centroids_.cols(); }
+
+        inline size_t getNumberOfProcessedPoints() const { return num_processed_points_; }
+
+    private:
+        typedef KMeans<ScalarT,EigenDim,DistAdaptor> KMeansType_;
+        typedef typename KMeansType_::DataAdaptorType_ DataAdaptorType_;
+        typedef typename KMeansType_::DistAdaptorType_ DistAdaptorType_;
+
+        size_t num_clusters_;
+        Eigen::Matrix<ScalarT,EigenDim,Eigen::Dynamic> cluster_centroids_;
+        std::vector<ScalarT> cluster_weights_;
+        Eigen::Matrix<ScalarT,EigenDim,Eigen::Dynamic> pending_points_;
+
+        ScalarT decay_factor_;
+        AssignmentMethod assignment_method_;
+        size_t random_seed_;
+
+        size_t num_processed_points_;
+
+        void update_(const ConstDataMatrixMap<ScalarT,EigenDim> &chunk) {
+            size_t num_clusters = cluster_centroids_.cols();
+            std::vector<size_t> assignments(getNearestClusterIndices(chunk));
+
+            // Per thread accumulators, reduced once per thread
+            Eigen::Matrix<ScalarT,EigenDim,Eigen::Dynamic> sums(Eigen::Matrix<ScalarT,EigenDim,Eigen::Dynamic>::Zero(chunk.rows(), num_clusters));
+            std::vector<size_t> counts(num_clusters, 0);
+#pragma omp parallel
+            {
+                Eigen::Matrix<ScalarT,EigenDim,Eigen::Dynamic> sums_local(Eigen::Matrix<ScalarT,EigenDim,Eigen::Dynamic>::Zero(chunk.rows(), num_clusters));
+                std::vector<size_t> counts_local(num_clusters, 0);
+#pragma omp for nowait
+                for (size_t i = 0; i < chunk.cols(); i++) {
+                    sums_local.col(assignments[i]) += chunk.col(i);
+                    counts_local[assignments[i]]++;
+                }
+#pragma omp critical
+                {
+                    sums += sums_local;
+                    for (size_t j = 0; j < num_clusters; j++) counts[j] += counts_local[j];
+                }
+            }
+
+            for (size_t j = 0; j < num_clusters; j++) {
+                ScalarT old_weight = decay_factor_*cluster_weights_[j];
+                cluster_weights_[j] = old_weight + counts[j];
+                if (counts[j] == 0) continue;
+                cluster_centroids_.col(j) = (old_weight*cluster_centroids_.col(j) + sums.col(j))/cluster_weights_[j];
+            }
+
+            num_processed_points_ += chunk.cols();
+        }
+    };
+
     typedef KMeans<float,2,KDTreeDistanceAdaptors::L2> KMeans2D;
     typedef KMeans<float,3,KDTreeDistanceAdaptors::L2> KMeans3D;
+
+    typedef StreamingKMeans<float,2,KDTreeDistanceAdaptors::L2> StreamingKMeans2D;
+    typedef StreamingKMeans<float,3,KDTreeDistanceAdaptors::L2> StreamingKMeans3D;
 }
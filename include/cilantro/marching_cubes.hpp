@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+#include <Eigen/Dense>
+
+namespace cilantro {
+    // Triangle lists (as triplets of cube edge indices) for all 256 configurations of corners below the iso-value.
+    // Corner c sits at offset (c&1, (c>>1)&1, (c>>2)&1); edge a*4+k is the k-th edge parallel to axis a, in increasing
+    // order of its start corner.
+    const std::vector<std::vector<unsigned char> >& getMarchingCubesTriangleTable();
+
+    // Iso-surface of a scalar field sampled at the nodes of a regular grid (node g at node_spacing*g) and stored
+    // sparsely in cubic blocks of block_resolution^3 values (x varying fastest). Cubes that touch a NaN (unobserved)
+    // node or a missing block are skipped. Blocks are processed in parallel; vertices are shared between adjacent
+    // faces, also across blocks. Face normals point towards values above iso_value. Every crossed grid edge with two
+    // observed endpoints gets a vertex, so next to unobserved regions a few vertices may be left unreferenced.
+    void marchingCubes(const std::vector<Eigen::Matrix<ptrdiff_t,3,1> > &block_coordinates,
+                       const std::vector<const float*> &block_values,
+                       size_t block_resolution,
+                       float node_spacing,
+                       float iso_value,
+                       std::vector<Eigen::Vector3f> &vertices,
+                       std::vector<std::vector<size_t> > &faces);
+
+    // Also interpolates per node attributes (e.g. colors), laid out like the values, at the mesh vertices
+    void marchingCubes(const std::vector<Eigen::Matrix<ptrdiff_t,3,1> > &block_coordinates,
+                       const std::vector<const float*> &block_values,
+                       const std::vector<const Eigen::Vector3f*> &block_attributes,
+                       size_t block_resolution,
+                       float node_spacing,
+                       float iso_value,
+                       std::vector<Eigen::Vector3f> &vertices,
+                       std::vector<std::vector<size_t> > &faces,
+                       std::vector<Eigen::Vector3f> &vertex_attributes);
+
+    // Dense size_x x size_y x size_z field (x varying fastest) with its first node at origin
+    void marchingCubes(const float *values,
+                       size_t size_x,
+                       size_t size_y,
+                       size_t size_z,
+                       float node_spacing,
+                       const Eigen::Vector3f &origin,
+                       float iso_value,
+                       std::vector<Eigen::Vector3f> &vertices,
+                       std::vector<std::vector<size_t> > &faces);
+}
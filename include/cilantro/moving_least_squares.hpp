@@ -0,0 +1,283 @@
+#pragma once
+
+#include <cilantro/principal_component_analysis.hpp>
+#include <cilantro/kd_tree.hpp>
+
+namespace cilantro {
+    // Fits, for every point, a polynomial height field over the weighted PCA (tangent) plane of its radius
+    // neighborhood, using Gaussian weights of the distance to the point. Polynomial orders below 2 reduce to plane
+    // projection. Points are processed in parallel.
+    template <typename ScalarT, ptrdiff_t EigenDim>
+    class MovingLeastSquares {
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        MovingLeastSquares(const ConstDataMatrixMap<ScalarT,EigenDim> &points)
+                : points_(points),
+                  kd_tree_ptr_(new KDTree<ScalarT,EigenDim,KDTreeDistanceAdaptors::L2>(points)),
+                  kd_tree_owned_(true),
+                  polynomial_order_(2),
+                  view_point_(Eigen::Matrix<ScalarT,EigenDim,1>::Zero(points.rows(), 1))
+        {}
+
+        MovingLeastSquares(const ConstDataMatrixMap<ScalarT,EigenDim> &points, const KDTree<ScalarT,EigenDim,KDTreeDistanceAdaptors::L2> &kd_tree)
+                : points_(points),
+                  kd_tree_ptr_(&kd_tree),
+                  kd_tree_owned_(false),
+                  polynomial_order_(2),
+                  view_point_(Eigen::Matrix<ScalarT,EigenDim,1>::Zero(points.rows(), 1))
+        {}
+
+        ~MovingLeastSquares() {
+            if (kd_tree_owned_) delete kd_tree_ptr_;
+        }
+
+        inline size_t getPolynomialOrder() const { return polynomial_order_; }
+        inline MovingLeastSquares& setPolynomialOrder(size_t order) { polynomial_order_ = order; return *this; }
+
+        // Normals are oriented towards the view point
+        inline const Eigen::Matrix<ScalarT,EigenDim,1>& getViewPoint() const { return view_point_; }
+        inline MovingLeastSquares& setViewPoint(const Eigen::Ref<const Eigen::Matrix<ScalarT,EigenDim,1> > &vp) { view_point_ = vp; return *this; }
+
+        // Projects every point onto its local surface. Points with fewer than dim neighbors are left in place, with
+        // NaN normals.
+        void smooth(ScalarT radius,
+                    Eigen::Matrix<ScalarT,EigenDim,Eigen::Dynamic> &smoothed_points,
+                    Eigen::Matrix<ScalarT,EigenDim,Eigen::Dynamic> &normals) const
+        {
+            size_t dim = points_.rows();
+            size_t num_points = points_.cols();
+            std::vector<std::vector<size_t> > exponents(get_exponents_(dim - 1, polynomial_order_));
+
+            smoothed_points.resize(dim, num_points);
+            normals.resize(dim, num_points);
+
+            std::vector<size_t> neighbors;
+            std::vector<ScalarT> distances;
+            LocalSurface_ surface;
+#pragma omp parallel for shared (smoothed_points, normals, exponents) private (neighbors, distances, surface) schedule (dynamic, 64)
+            for (size_t i = 0; i < num_points; i++) {
+                if (!fit_surface_(points_.col(i), radius, exponents, neighbors, distances, surface)) {
+                    smoothed_points.col(i) = points_.col(i);
+                    normals.col(i).setConstant(std::numeric_limits<ScalarT>::quiet_NaN());
+                    continue;
+                }
+                Eigen::Matrix<ScalarT,Eigen::Dynamic,1> u(surface.tangent.transpose()*(points_.col(i) - surface.mean));
+                Eigen::Matrix<ScalarT,EigenDim,1> normal(dim, 1);
+                smoothed_points.col(i) = surface_point_(surface, exponents, u, normal);
+                normals.col(i) = normal;
+            }
+        }
+
+        // Samples every local surface on a regular grid of spacing step over its tangent plane, within radius/2 of the
+        // neighborhood mean. Samples outside the extent of the neighborhood's tangent coordinates along the axis and
+        // diagonal directions (a polytope around their convex hull) are dropped, so that surfaces are not extrapolated
+        // past the boundary of the cloud. Only samples closer to the generating point than to any other input point
+        // are kept, so that neighboring surfaces do not produce overlapping samples. The output order is unspecified.
+        void upsample(ScalarT radius,
+                      ScalarT step,
+                      Eigen::Matrix<ScalarT,EigenDim,Eigen::Dynamic> &upsampled_points,
+                      Eigen::Matrix<ScalarT,EigenDim,Eigen::Dynamic> &normals) const
+        {
+            size_t dim = points_.rows();
+            size_t num_points = points_.cols();
+            std::vector<std::vector<size_t> > exponents(get_exponents_(dim - 1, polynomial_order_));
+
+            ScalarT sample_radius = radius/2;
+            ptrdiff_t half_width = (step > (ScalarT)0.0) ? (ptrdiff_t)std::floor(sample_radius/step) : 0;
+            size_t samples_per_axis = 2*half_width + 1;
+            size_t samples_per_point = 1;
+            for (size_t a = 0; a < dim - 1; a++) samples_per_point *= samples_per_axis;
+
+            // Nonzero directions with coordinates in {-1,0,1}, one of each opposite pair is enough for both signs
+            size_t num_lattice = 1;
+            for (size_t a = 0; a < dim - 1; a++) num_lattice *= 3;
+            Eigen::Matrix<ScalarT,Eigen::Dynamic,Eigen::Dynamic> directions(dim - 1, (num_lattice - 1)/2);
+            for (size_t d = 0; d < directions.cols(); d++) {
+                size_t rem = d + (num_lattice + 1)/2;
+                for (size_t a = 0; a < dim - 1; a++) {
+                    directions(a, d) = (ScalarT)((ptrdiff_t)(rem % 3) - 1);
+                    rem /= 3;
+                }
+            }
+
+            std::vector<Eigen::Matrix<ScalarT,EigenDim,1>,Eigen::aligned_allocator<Eigen::Matrix<ScalarT,EigenDim,1> > > all_points, all_normals;
+            all_points.reserve(num_points);
+            all_normals.reserve(num_points);
+
+#pragma omp parallel shared (exponents, all_points, all_normals)
+            {
+                std::vector<size_t> neighbors;
+                std::vector<ScalarT> distances;
+                LocalSurface_ surface;
+                Eigen::Matrix<ScalarT,Eigen::Dynamic,1> u(dim - 1), extent_min, extent_max, projected;
+                Eigen::Matrix<ScalarT,Eigen::Dynamic,Eigen::Dynamic> neighborhood_u;
+                Eigen::Matrix<ScalarT,EigenDim,1> point(dim, 1), normal(dim, 1);
+                std::vector<Eigen::Matrix<ScalarT,EigenDim,1>,Eigen::aligned_allocator<Eigen::Matrix<ScalarT,EigenDim,1> > > thread_points, thread_normals;
+#pragma omp for nowait schedule (dynamic, 64)
+                for (size_t i = 0; i < num_points; i++) {
+                    if (!fit_surface_(points_.col(i), radius, exponents, neighbors, distances, surface)) continue;
+                    neighborhood_u.resize(dim - 1, neighbors.size());
+                    for (size_t j = 0; j < neighbors.size(); j++) {
+                        neighborhood_u.col(j) = surface.tangent.transpose()*(points_.col(neighbors[j]) - surface.mean);
+                    }
+                    neighborhood_u = directions.transpose()*neighborhood_u;
+                    extent_min = neighborhood_u.rowwise().minCoeff();
+                    extent_max = neighborhood_u.rowwise().maxCoeff();
+                    for (size_t s = 0; s < samples_per_point; s++) {
+                        size_t rem = s;
+                        for (size_t a = 0; a < dim - 1; a++) {
+                            u[a] = step*((ptrdiff_t)(rem % samples_per_axis) - half_width);
+                            rem /= samples_per_axis;
+                        }
+                        if (u.squaredNorm() > sample_radius*sample_radius) continue;
+                        projected = directions.transpose()*u;
+                        if ((projected.array() < extent_min.array()).any() || (projected.array() > extent_max.array()).any()) continue;
+                        point = surface_point_(surface, exponents, u, normal);
+                        size_t nn;
+                        ScalarT nn_dist;
+                        kd_tree_ptr_->nearestNeighborSearch(point, nn, nn_dist);
+                        if (nn != i && nn_dist < (points_.col(i) - point).squaredNorm()) continue;
+                        thread_points.emplace_back(point);
+                        thread_normals.emplace_back(normal);
+                    }
+                }
+#pragma omp critical
+                {
+                    all_points.insert(all_points.end(), thread_points.begin(), thread_points.end());
+                    all_normals.insert(all_normals.end(), thread_normals.begin(), thread_normals.end());
+                }
+            }
+
+            upsampled_points.resize(dim, all_points.size());
+            normals.resize(dim, all_normals.size());
+            for (size_t i = 0; i < all_points.size(); i++) {
+                upsampled_points.col(i) = all_points[i];
+                normals.col(i) = all_normals[i];
+            }
+        }
+
+    private:
+        ConstDataMatrixMap<ScalarT,EigenDim> points_;
+        const KDTree<ScalarT,EigenDim,KDTreeDistanceAdaptors::L2> *kd_tree_ptr_;
+        bool kd_tree_owned_;
+        size_t polynomial_order_;
+        Eigen::Matrix<ScalarT,EigenDim,1> view_point_;
+
+        // Height along normal is given by the polynomial with the given coefficients over tangent plane coordinates
+        // (relative to mean)
+        struct LocalSurface_ {
+            Eigen::Matrix<ScalarT,EigenDim,1> mean;
+            Eigen::Matrix<ScalarT,EigenDim,Eigen::Dynamic> tangent;
+            Eigen::Matrix<ScalarT,EigenDim,1> normal;
+            Eigen::Matrix<ScalarT,Eigen::Dynamic,1> coefficients;
+        };
+
+        // Exponents of all monomials in num_vars variables of degree up to max_degree (none for plane projection)
+        static std::vector<std::vector<size_t> > get_exponents_(size_t num_vars, size_t max_degree) {
+            std::vector<std::vector<size_t> > exponents;
+            if (max_degree < 2 || num_vars == 0) return exponents;
+            std::vector<size_t> curr(num_vars, 0);
+            exponents.emplace_back(curr);
+            while (true) {
+                size_t a = 0;
+                while (a < num_vars) {
+                    curr[a]++;
+                    size_t degree = 0;
+                    for (size_t b = 0; b < num_vars; b++) degree += curr[b];
+                    if (degree <= max_degree) break;
+                    curr[a] = 0;
+                    a++;
+                }
+                if (a == num_vars) break;
+                exponents.emplace_back(curr);
+            }
+            return exponents;
+        }
+
+        static inline ScalarT monomial_(const Eigen::Matrix<ScalarT,Eigen::Dynamic,1> &u, const std::vector<size_t> &exponent) {
+            ScalarT val = 1.0;
+            for (size_t a = 0; a < exponent.size(); a++) {
+                for (size_t e = 0; e < exponent[a]; e++) val *= u[a];
+            }
+            return val;
+        }
+
+        bool fit_surface_(const Eigen::Ref<const Eigen::Matrix<ScalarT,EigenDim,1> > &query_pt,
+                          ScalarT radius,
+                          const std::vector<std::vector<size_t> > &exponents,
+                          std::vector<size_t> &neighbors,
+                          std::vector<ScalarT> &distances,
+                          LocalSurface_ &surface) const
+        {
+            size_t dim = points_.rows();
+            kd_tree_ptr_->radiusSearch(query_pt, radius*radius, neighbors, distances);
+            if (neighbors.size() < dim) return false;
+
+            Eigen::Matrix<ScalarT,EigenDim,Eigen::Dynamic> neighborhood(dim, neighbors.size());
+            std::vector<ScalarT> weights(neighbors.size());
+            for (size_t j = 0; j < neighbors.size(); j++) {
+                neighborhood.col(j) = points_.col(neighbors[j]);
+                weights[j] = std::exp(-distances[j]/(radius*radius));
+            }
+
+            PrincipalComponentAnalysis<ScalarT,EigenDim> pca(neighborhood, weights);
+            surface.mean = pca.getDataMean();
+            surface.tangent = pca.getEigenVectors().leftCols(dim - 1);
+            surface.normal = pca.getEigenVectors().col(dim - 1);
+
+            // Weighted least squares through the normal equations; too small neighborhoods fall back to the plane
+            size_t num_terms = exponents.size();
+            surface.coefficients.setZero(num_terms);
+            if (num_terms == 0 || neighbors.size() < num_terms) return true;
+
+            Eigen::Matrix<ScalarT,Eigen::Dynamic,Eigen::Dynamic> lhs(Eigen::Matrix<ScalarT,Eigen::Dynamic,Eigen::Dynamic>::Zero(num_terms, num_terms));
+            Eigen::Matrix<ScalarT,Eigen::Dynamic,1> rhs(Eigen::Matrix<ScalarT,Eigen::Dynamic,1>::Zero(num_terms));
+            Eigen::Matrix<ScalarT,Eigen::Dynamic,1> u(dim - 1), terms(num_terms);
+            for (size_t j = 0; j < neighbors.size(); j++) {
+                Eigen::Matrix<ScalarT,EigenDim,1> centered(neighborhood.col(j) - surface.mean);
+                u = surface.tangent.transpose()*centered;
+                for (size_t t = 0; t < num_terms; t++) terms[t] = monomial_(u, exponents[t]);
+                lhs.noalias() += (weights[j]*terms)*terms.transpose();
+                rhs += (weights[j]*surface.normal.dot(centered))*terms;
+            }
+            Eigen::LDLT<Eigen::Matrix<ScalarT,Eigen::Dynamic,Eigen::Dynamic> > ldlt(lhs);
+            if (ldlt.info() == Eigen::Success) {
+                surface.coefficients = ldlt.solve(rhs);
+                if (!surface.coefficients.allFinite()) surface.coefficients.setZero();
+            }
+
+            return true;
+        }
+
+        // Surface point and unit normal at tangent coordinates u
+        Eigen::Matrix<ScalarT,EigenDim,1> surface_point_(const LocalSurface_ &surface,
+                                                         const std::vector<std::vector<size_t> > &exponents,
+                                                         const Eigen::Matrix<ScalarT,Eigen::Dynamic,1> &u,
+                                                         Eigen::Matrix<ScalarT,EigenDim,1> &normal) const
+        {
+            ScalarT height = 0.0;
+            Eigen::Matrix<ScalarT,Eigen::Dynamic,1> gradient(Eigen::Matrix<ScalarT,Eigen::Dynamic,1>::Zero(u.size()));
+            for (size_t t = 0; t < exponents.size(); t++) {
+                height += surface.coefficients[t]*monomial_(u, exponents[t]);
+                for (size_t a = 0; a < exponents[t].size(); a++) {
+                    if (exponents[t][a] == 0) continue;
+                    ScalarT val = surface.coefficients[t]*exponents[t][a];
+                    for (size_t b = 0; b < exponents[t].size(); b++) {
+                        size_t e = exponents[t][b] - (size_t)(a == b);
+                        for (size_t k = 0; k < e; k++) val *= u[b];
+                    }
+                    gradient[a] += val;
+                }
+            }
+
+            Eigen::Matrix<ScalarT,EigenDim,1> point(surface.mean + surface.tangent*u + height*surface.normal);
+            normal = (surface.normal - surface.tangent*gradient).normalized();
+            if (normal.dot(view_point_ - point) < 0.0) normal *= -1.0;
+            return point;
+        }
+    };
+
+    typedef MovingLeastSquares<float,2> MovingLeastSquares2D;
+    typedef MovingLeastSquares<float,3> MovingLeastSquares3D;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cilantro/kd_tree.hpp>
+
+namespace cilantro {
+    // Masks are true for the points to keep (see PointCloud::select). Queries run in parallel, each thread reusing a
+    // single set of neighbor buffers.
+    template <typename ScalarT, ptrdiff_t EigenDim>
+    class OutlierRemoval {
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        OutlierRemoval(const ConstDataMatrixMap<ScalarT,EigenDim> &points)
+                : points_(points),
+                  kd_tree_ptr_(new KDTree<ScalarT,EigenDim,KDTreeDistanceAdaptors::L2>(points)),
+                  kd_tree_owned_(true)
+        {}
+
+        OutlierRemoval(const ConstDataMatrixMap<ScalarT,EigenDim> &points, const KDTree<ScalarT,EigenDim,KDTreeDistanceAdaptors::L2> &kd_tree)
+                : points_(points),
+                  kd_tree_ptr_(&kd_tree),
+                  kd_tree_owned_(false)
+        {}
+
+        ~OutlierRemoval() {
+            if (kd_tree_owned_) delete kd_tree_ptr_;
+        }
+
+        // Mean distance of each point to its num_neighbors nearest neighbors (excluding itself)
+        std::vector<ScalarT> getMeanNeighborDistances(size_t num_neighbors) const {
+            size_t num_points = points_.cols();
+            std::vector<ScalarT> mean_distances(num_points, (ScalarT)0.0);
+            if (num_neighbors == 0) return mean_distances;
+
+#pragma omp parallel
+            {
+                std::vector<size_t> neighbors(num_neighbors + 1);
+                std::vector<ScalarT> distances(num_neighbors + 1);
+#pragma omp for schedule (dynamic, 256)
+                for (size_t i = 0; i < num_points; i++) {
+                    size_t num_found = kd_tree_ptr_->kNNSearch(points_.col(i), num_neighbors + 1, neighbors.data(), distances.data());
+                    // The first result is the query point itself (or a duplicate of it)
+                    ScalarT sum = 0.0;
+                    for (size_t j = 1; j < num_found; j++) {
+                        sum += std::sqrt(distances[j]);
+                    }
+                    mean_distances[i] = (num_found > 1) ? sum/(num_found - 1) : std::numeric_limits<ScalarT>::infinity();
+                }
+            }
+
+            return mean_distances;
+        }
+
+        // Keeps points whose mean neighbor distance is at most std_mul standard deviations above the global mean
+        std::vector<bool> getStatisticalInlierMask(size_t num_neighbors, ScalarT std_mul) const {
+            std::vector<ScalarT> mean_distances(getMeanNeighborDistances(num_neighbors));
+            size_t num_points = mean_distances.size();
+
+            double sum = 0.0, sum_sq = 0.0;
+            size_t num_valid = 0;
+#pragma omp parallel for reduction (+:sum,sum_sq,num_valid)
+            for (size_t i = 0; i < num_points; i++) {
+                if (!std::isfinite(mean_distances[i])) continue;
+                sum += mean_distances[i];
+                sum_sq += mean_distances[i]*mean_distances[i];
+                num_valid++;
+            }
+
+            std::vector<bool> mask(num_points, false);
+            if (num_valid == 0) return mask;
+
+            double mean = sum/num_valid;
+            double std_dev = std::sqrt(std::max(sum_sq/num_valid - mean*mean, 0.0));
+            ScalarT threshold = (ScalarT)(mean + std_mul*std_dev);
+            for (size_t i = 0; i < num_points; i++) {
+                mask[i] = mean_distances[i] <= threshold;
+            }
+
+            return mask;
+        }
+
+        // Keeps points that have at least min_neighbors other points within radius; counting stops as soon as enough
+        // are found
+        std::vector<bool> getRadiusInlierMask(ScalarT radius, size_t min_neighbors) const {
+            size_t num_points = points_.cols();
+            ScalarT radius_sq = radius*radius;
+
+            // Written in parallel as bytes, since std::vector<bool> entries share words
+            std::vector<unsigned char> keep(num_points);
+#pragma omp parallel for schedule (dynamic, 256)
+            for (size_t i = 0; i < num_points; i++) {
+                keep[i] = kd_tree_ptr_->radiusCount(points_.col(i), radius_sq, min_neighbors + 1) > min_neighbors;
+            }
+
+            return std::vector<bool>(keep.begin(), keep.end());
+        }
+
+    private:
+        ConstDataMatrixMap<ScalarT,EigenDim> points_;
+        const KDTree<ScalarT,EigenDim,KDTreeDistanceAdaptors::L2> *kd_tree_ptr_;
+        bool kd_tree_owned_;
+    };
+
+    typedef OutlierRemoval<float,2> OutlierRemoval2D;
+    typedef OutlierRemoval<float,3> OutlierRemoval3D;
+}
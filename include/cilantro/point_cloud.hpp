@@ -11,6 +11,8 @@ namespace cilantro {
         PointCloud(const std::vector<Eigen::Vector3f> &points);
         PointCloud(const std::vector<Eigen::Vector3f> &points, const std::vector<Eigen::Vector3f> &normals, const std::vector<Eigen::Vector3f> &colors);
         PointCloud(const PointCloud &cloud, const std::vector<size_t> &indices, bool negate = false);
+        // Points whose mask entry is true (false, if negate is set), in their original order
+        PointCloud(const PointCloud &cloud, const std::vector<bool> &mask, bool negate = false);
 
         std::vector<Eigen::Vector3f> points;
         std::vector<Eigen::Vector3f> normals;
@@ -24,6 +26,8 @@ namespace cilantro {
 
         PointCloud& append(const PointCloud &cloud);
         PointCloud& remove(const std::vector<size_t> &indices);
+        // Keeps the points whose mask entry is true, preserving their order; linear time, in place
+        PointCloud& select(const std::vector<bool> &mask);
 
         PointCloud& removeInvalidPoints();
         PointCloud& removeInvalidNormals();
@@ -22,6 +22,33 @@ namespace cilantro {
             eigenvalues_ = svd.singularValues().array().square();
         }
 
+        // Weighted mean and scatter; eigenvalues are those of the weighted scatter matrix
+        PrincipalComponentAnalysis(const ConstDataMatrixMap<ScalarT,EigenDim> &data, const std::vector<ScalarT> &weights) {
+            ScalarT weight_sum = 0.0;
+            mean_.setZero(data.rows(), 1);
+            for (size_t i = 0; i < data.cols(); i++) {
+                mean_ += weights[i]*data.col(i);
+                weight_sum += weights[i];
+            }
+            if (weight_sum > (ScalarT)0.0) mean_ /= weight_sum;
+
+            Eigen::Matrix<ScalarT,EigenDim,EigenDim> scatter(Eigen::Matrix<ScalarT,EigenDim,EigenDim>::Zero(data.rows(), data.rows()));
+            for (size_t i = 0; i < data.cols(); i++) {
+                Eigen::Matrix<ScalarT,EigenDim,1> centered(data.col(i) - mean_);
+                scatter.noalias() += (weights[i]*centered)*centered.transpose();
+            }
+
+            // Eigen returns ascending eigenvalues
+            Eigen::SelfAdjointEigenSolver<Eigen::Matrix<ScalarT,EigenDim,EigenDim>> eig(scatter);
+            eigenvectors_ = eig.eigenvectors().rowwise().reverse();
+            if (eigenvectors_.determinant() < 0.0) {
+                ptrdiff_t last_col_ind = data.rows() - 1;
+                eigenvectors_.col(last_col_ind) = -eigenvectors_.col(last_col_ind);
+            }
+
+            eigenvalues_ = eig.eigenvalues().reverse();
+        }
+
         ~PrincipalComponentAnalysis() {}
 
         inline const Eigen::Matrix<ScalarT,EigenDim,1>& getDataMean() const { return mean_; }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <random>
 #include <cilantro/convex_polytope.hpp>
 
 namespace cilantro {
@@ -25,17 +26,22 @@ namespace cilantro {
         SpaceRegion(const ConvexPolytopeVector &polytopes)
                 : dim_((EigenDim != Eigen::Dynamic) ? EigenDim : ((polytopes.empty()) ? 2 : polytopes[0].getSpaceDimension())),
                   polytopes_(polytopes)
-        {}
+        {
+            build_bounding_volume_hierarchy_();
+        }
 
         SpaceRegion(const ConvexPolytope<InputScalarT,OutputScalarT,EigenDim> &polytope)
                 : dim_(polytope.getSpaceDimension()), polytopes_(ConvexPolytopeVector(1,polytope))
-        {}
+        {
+            build_bounding_volume_hierarchy_();
+        }
 
         template <ptrdiff_t Dim = EigenDim, class = typename std::enable_if<Dim != Eigen::Dynamic>::type>
         SpaceRegion(const ConstDataMatrixMap<InputScalarT,EigenDim> &points, bool compute_topology = false, bool simplicial_facets = false, double merge_tol = 0.0)
                 : dim_(EigenDim)
         {
             polytopes_.emplace_back(points, compute_topology, simplicial_facets, merge_tol);
+            build_bounding_volume_hierarchy_();
         }
 
         template <ptrdiff_t Dim = EigenDim, class = typename std::enable_if<Dim != Eigen::Dynamic>::type>
@@ -43,6 +49,7 @@ namespace cilantro {
                 : dim_(EigenDim)
         {
             polytopes_.emplace_back(halfspaces, compute_topology, simplicial_facets, merge_tol, dist_tol);
+            build_bounding_volume_hierarchy_();
         }
 
         template <ptrdiff_t Dim = EigenDim, class = typename std::enable_if<Dim == Eigen::Dynamic>::type>
@@ -50,6 +57,7 @@ namespace cilantro {
                 : dim_(dim)
         {
             polytopes_.emplace_back(input_data, dim, compute_topology, simplicial_facets, merge_tol, dist_tol);
+            build_bounding_volume_hierarchy_();
         }
 
         ~SpaceRegion() {}
@@ -151,56 +159,80 @@ namespace cilantro {
             return true;
         }
 
-        // Inefficient
-        template <ptrdiff_t Dim = EigenDim>
-        typename std::enable_if<Dim != Eigen::Dynamic, double>::type getVolume(double merge_tol = 0.0, double dist_tol = std::numeric_limits<InputScalarT>::epsilon()) const {
+        // Inclusion-exclusion over the intersecting subsets of polytopes only: subsets are grown one polytope at a time
+        // (in tree leaf order), candidates must overlap the current intersection's bounding box, and subsets with
+        // empty or flat intersections are not grown further, as all their supersets are too. Each first polytope's
+        // subsets are handled in parallel. The pruning does not help when many polytopes share a common region: for n
+        // nested or mutually overlapping polytopes all 2^n subsets intersect (about 1s for 14 nested boxes, 4s for
+        // 16). Use estimateVolume for such regions.
+        double getVolume(double merge_tol = 0.0, double dist_tol = std::numeric_limits<InputScalarT>::epsilon()) const {
             if (!isBounded()) return std::numeric_limits<double>::infinity();
 
-            ConvexPolytopeVector subsets;
-            subsets.emplace_back(InequalityMatrix<InputScalarT,EigenDim>(EigenDim+1, 0));
+            std::vector<size_t> leaves;
+            for (size_t n = 0; n < bvh_nodes_.size(); n++) {
+                if (bvh_nodes_[n].right == 0) leaves.emplace_back(n);
+            }
 
-            std::vector<size_t> subset_sizes;
-            subset_sizes.emplace_back(0);
             double volume = 0.0;
-            for (size_t i = 0; i < polytopes_.size(); i++) {
-                ConvexPolytopeVector subsets_tmp(subsets);
-                std::vector<size_t> subset_sizes_tmp(subset_sizes);
-                for (size_t j = 0; j < subsets_tmp.size(); j++) {
-                    subsets_tmp[j] = subsets_tmp[j].intersectionWith(polytopes_[i], false, false, merge_tol, dist_tol);
-                    subset_sizes_tmp[j]++;
-                    volume += (2.0*(subset_sizes_tmp[j]%2) - 1.0)*subsets_tmp[j].getVolume();
-                }
-                std::move(std::begin(subsets_tmp), std::end(subsets_tmp), std::back_inserter(subsets));
-                std::move(std::begin(subset_sizes_tmp), std::end(subset_sizes_tmp), std::back_inserter(subset_sizes));
+#pragma omp parallel for schedule (dynamic) reduction (+:volume)
+            for (size_t i = 0; i < leaves.size(); i++) {
+                std::vector<size_t> candidates;
+                get_overlapping_leaves_(bvh_min_.col(leaves[i]), bvh_max_.col(leaves[i]), leaves[i] + 1, candidates);
+                std::sort(candidates.begin(), candidates.end());
+                volume += get_intersection_volume_sum_(polytopes_[bvh_nodes_[leaves[i]].polytope], candidates, 0, merge_tol, dist_tol);
             }
 
             return volume;
         }
 
-        // Inefficient
-        template <ptrdiff_t Dim = EigenDim>
-        typename std::enable_if<Dim == Eigen::Dynamic, double>::type getVolume(double merge_tol = 0.0, double dist_tol = std::numeric_limits<InputScalarT>::epsilon()) const {
-            if (!isBounded()) return std::numeric_limits<double>::infinity();
+        // Monte Carlo estimate for large or heavily overlapping unions. Samples are drawn uniformly from the polytope
+        // bounding boxes (picked with probability proportional to their volume) and count if their polytope is the
+        // first one to contain them, so the estimate is unbiased and its standard error, returned in std_error, scales
+        // with the total box volume rather than that of the region's bounding box. Samples are drawn in parallel, in
+        // fixed size chunks seeded from random_seed, so results do not depend on the number of threads.
+        double estimateVolume(size_t num_samples, double &std_error, size_t random_seed = std::random_device()()) const {
+            if (!isBounded()) {
+                std_error = std::numeric_limits<double>::infinity();
+                return std::numeric_limits<double>::infinity();
+            }
 
-            ConvexPolytopeVector subsets;
-            subsets.emplace_back(InequalityMatrix<InputScalarT,EigenDim>(dim_+1, 0), dim_);
+            std::vector<size_t> leaves;
+            std::vector<double> cumulative_volumes;
+            double box_volume = 0.0;
+            for (size_t n = 0; n < bvh_nodes_.size(); n++) {
+                if (bvh_nodes_[n].right != 0) continue;
+                box_volume += (bvh_max_.col(n) - bvh_min_.col(n)).template cast<double>().prod();
+                leaves.emplace_back(n);
+                cumulative_volumes.emplace_back(box_volume);
+            }
+            if (leaves.empty() || num_samples == 0) {
+                std_error = (leaves.empty()) ? 0.0 : std::numeric_limits<double>::infinity();
+                return 0.0;
+            }
 
-            std::vector<size_t> subset_sizes;
-            subset_sizes.emplace_back(0);
-            double volume = 0.0;
-            for (size_t i = 0; i < polytopes_.size(); i++) {
-                ConvexPolytopeVector subsets_tmp(subsets);
-                std::vector<size_t> subset_sizes_tmp(subset_sizes);
-                for (size_t j = 0; j < subsets_tmp.size(); j++) {
-                    subsets_tmp[j] = subsets_tmp[j].intersectionWith(polytopes_[i], false, false, merge_tol, dist_tol);
-                    subset_sizes_tmp[j]++;
-                    volume += (2.0*(subset_sizes_tmp[j]%2) - 1.0)*subsets_tmp[j].getVolume();
+            const size_t chunk_size = 4096;
+            size_t num_chunks = (num_samples - 1)/chunk_size + 1;
+            size_t num_hits = 0;
+#pragma omp parallel for reduction (+:num_hits)
+            for (size_t k = 0; k < num_chunks; k++) {
+                std::mt19937 rng(random_seed + k);
+                std::uniform_real_distribution<double> box_dist(0.0, box_volume);
+                std::uniform_real_distribution<OutputScalarT> unit_dist(0.0, 1.0);
+                Eigen::Matrix<OutputScalarT,EigenDim,1> point(dim_);
+                size_t end = std::min((k+1)*chunk_size, num_samples);
+                for (size_t s = k*chunk_size; s < end; s++) {
+                    size_t l = std::min((size_t)(std::upper_bound(cumulative_volumes.begin(), cumulative_volumes.end(), box_dist(rng)) - cumulative_volumes.begin()), leaves.size() - 1);
+                    size_t n = leaves[l];
+                    for (size_t d = 0; d < dim_; d++) {
+                        point(d) = bvh_min_(d,n) + (bvh_max_(d,n) - bvh_min_(d,n))*unit_dist(rng);
+                    }
+                    if (polytopes_[bvh_nodes_[n].polytope].containsPoint(point) && !bvh_contains_point_(point, 0.0, n)) num_hits++;
                 }
-                std::move(std::begin(subsets_tmp), std::end(subsets_tmp), std::back_inserter(subsets));
-                std::move(std::begin(subset_sizes_tmp), std::end(subset_sizes_tmp), std::back_inserter(subset_sizes));
             }
 
-            return volume;
+            double ratio = (double)num_hits/num_samples;
+            std_error = box_volume*std::sqrt(ratio*(1.0 - ratio)/num_samples);
+            return box_volume*ratio;
         }
 
         inline const ConvexPolytopeVector& getConvexPolytopes() const { return polytopes_; }
@@ -212,34 +244,57 @@ namespace cilantro {
             return Eigen::Matrix<OutputScalarT,EigenDim,1>::Constant(dim_, 1, std::numeric_limits<OutputScalarT>::quiet_NaN());;
         }
 
+        // Only polytopes whose bounding boxes contain the point are tested. Negative offsets grow polytopes past their
+        // bounding boxes, so all polytopes are tested then.
         inline bool containsPoint(const Eigen::Ref<const Eigen::Matrix<OutputScalarT,EigenDim,1> > &point, OutputScalarT offset = 0.0) const {
-            for (size_t i = 0; i < polytopes_.size(); i++) {
-                if (polytopes_[i].containsPoint(point, offset)) return true;
+            if (offset < (OutputScalarT)0.0) {
+                for (size_t i = 0; i < polytopes_.size(); i++) {
+                    if (polytopes_[i].containsPoint(point, offset)) return true;
+                }
+                return false;
             }
-            return false;
+
+            for (size_t i = 0; i < unbounded_polytopes_.size(); i++) {
+                if (polytopes_[unbounded_polytopes_[i]].containsPoint(point, offset)) return true;
+            }
+            return bvh_contains_point_(point, offset, bvh_nodes_.size());
         }
 
+        // Regions of a few polytopes are tested all at once (see computeHalfspaceIntersectionUnionMembership); larger
+        // ones point by point, in parallel, through the bounding volume hierarchy
         Eigen::Matrix<bool,1,Eigen::Dynamic> getInteriorPointsIndexMask(const ConstDataMatrixMap<OutputScalarT,EigenDim> &points, OutputScalarT offset = 0.0) const {
-            Eigen::Matrix<bool,1,Eigen::Dynamic> mask(1,points.cols());
-            for (size_t i = 0; i < points.cols(); i++) {
-                mask(i) = containsPoint(points.col(i), offset);
+            if (polytopes_.size() > 4 && offset >= (OutputScalarT)0.0) {
+                Eigen::Matrix<bool,1,Eigen::Dynamic> mask(points.cols());
+#pragma omp parallel for
+                for (size_t i = 0; i < points.cols(); i++) {
+                    mask(i) = containsPoint(points.col(i), offset);
+                }
+                return mask;
+            }
+
+            std::vector<size_t> group_offsets(polytopes_.size() + 1, 0);
+            for (size_t i = 0; i < polytopes_.size(); i++) {
+                group_offsets[i+1] = group_offsets[i] + polytopes_[i].getFacetHyperplanes().cols();
+            }
+            InequalityMatrix<OutputScalarT,EigenDim> halfspaces(dim_+1, group_offsets.back());
+            for (size_t i = 0; i < polytopes_.size(); i++) {
+                halfspaces.middleCols(group_offsets[i], group_offsets[i+1] - group_offsets[i]) = polytopes_[i].getFacetHyperplanes();
             }
+
+            Eigen::Matrix<bool,1,Eigen::Dynamic> mask;
+            computeHalfspaceIntersectionUnionMembership<OutputScalarT,EigenDim>(halfspaces, group_offsets, points, mask, offset);
             return mask;
         }
 
         std::vector<size_t> getInteriorPointIndices(const ConstDataMatrixMap<OutputScalarT,EigenDim> &points, OutputScalarT offset = 0.0) const {
-            std::vector<size_t> indices;
-            indices.reserve(points.cols());
-            for (size_t i = 0; i < points.cols(); i++) {
-                if (containsPoint(points.col(i), offset)) indices.emplace_back(i);
-            }
-            return indices;
+            return getIndexMaskTrueIndices(getInteriorPointsIndexMask(points, offset));
         }
 
         SpaceRegion& transform(const Eigen::Ref<const Eigen::Matrix<OutputScalarT,EigenDim,EigenDim> > &rotation, const Eigen::Ref<const Eigen::Matrix<OutputScalarT,EigenDim,1> > &translation) {
             for (size_t i = 0; i < polytopes_.size(); i++) {
                 polytopes_[i].transform(rotation, translation);
             }
+            build_bounding_volume_hierarchy_();
             return *this;
         }
 
@@ -248,6 +303,7 @@ namespace cilantro {
             for (size_t i = 0; i < polytopes_.size(); i++) {
                 polytopes_[i].transform(rigid_transform);
             }
+            build_bounding_volume_hierarchy_();
             return *this;
         }
 
@@ -256,12 +312,166 @@ namespace cilantro {
             for (size_t i = 0; i < polytopes_.size(); i++) {
                 polytopes_[i].transform(rigid_transform);
             }
+            build_bounding_volume_hierarchy_();
             return *this;
         }
 
     protected:
+        // Leaves hold one polytope each and have no right child; the left child of an inner node directly follows it
+        struct BoundingVolumeNode_ {
+            BoundingVolumeNode_(size_t polytope, size_t right) : polytope(polytope), right(right) {}
+            size_t polytope;
+            size_t right;
+        };
+
+        struct PolytopeCenterComparator_ {
+            PolytopeCenterComparator_(const Eigen::Matrix<OutputScalarT,EigenDim,Eigen::Dynamic> &centers, size_t axis) : centers(centers), axis(axis) {}
+            inline bool operator()(size_t i, size_t j) { return centers(axis,i) < centers(axis,j); }
+            const Eigen::Matrix<OutputScalarT,EigenDim,Eigen::Dynamic>& centers;
+            size_t axis;
+        };
+
         size_t dim_;
         ConvexPolytopeVector polytopes_;
+
+        // Axis aligned bounding box tree over the bounded polytopes (from their vertices); node boxes are columns
+        std::vector<BoundingVolumeNode_> bvh_nodes_;
+        Eigen::Matrix<OutputScalarT,EigenDim,Eigen::Dynamic> bvh_min_;
+        Eigen::Matrix<OutputScalarT,EigenDim,Eigen::Dynamic> bvh_max_;
+        std::vector<size_t> unbounded_polytopes_;
+
+        void build_bounding_volume_hierarchy_() {
+            bvh_nodes_.clear();
+            unbounded_polytopes_.clear();
+
+            // Empty polytopes contain nothing and are left out
+            std::vector<size_t> bounded;
+            for (size_t i = 0; i < polytopes_.size(); i++) {
+                if (polytopes_[i].isEmpty()) continue;
+                if (polytopes_[i].isBounded() && polytopes_[i].getVertices().cols() > 0) {
+                    bounded.emplace_back(i);
+                } else {
+                    unbounded_polytopes_.emplace_back(i);
+                }
+            }
+
+            size_t num_nodes = (bounded.empty()) ? 0 : 2*bounded.size() - 1;
+            bvh_nodes_.reserve(num_nodes);
+            bvh_min_.resize(dim_, num_nodes);
+            bvh_max_.resize(dim_, num_nodes);
+            if (bounded.empty()) return;
+
+            Eigen::Matrix<OutputScalarT,EigenDim,Eigen::Dynamic> poly_min(dim_, polytopes_.size());
+            Eigen::Matrix<OutputScalarT,EigenDim,Eigen::Dynamic> poly_max(dim_, polytopes_.size());
+#pragma omp parallel for
+            for (size_t i = 0; i < bounded.size(); i++) {
+                // Padded, so that points the inequalities accept within rounding error are not culled
+                const PointMatrix<OutputScalarT,EigenDim>& vertices(polytopes_[bounded[i]].getVertices());
+                OutputScalarT pad = 16*std::numeric_limits<OutputScalarT>::epsilon()*vertices.cwiseAbs().maxCoeff();
+                poly_min.col(bounded[i]) = vertices.rowwise().minCoeff().array() - pad;
+                poly_max.col(bounded[i]) = vertices.rowwise().maxCoeff().array() + pad;
+            }
+            build_bounding_volume_node_(bounded, 0, bounded.size(), poly_min, poly_max, poly_min + poly_max);
+        }
+
+        // Median split along the axis of largest extent of the box centers
+        size_t build_bounding_volume_node_(std::vector<size_t> &indices, size_t begin, size_t end,
+                                           const Eigen::Matrix<OutputScalarT,EigenDim,Eigen::Dynamic> &poly_min,
+                                           const Eigen::Matrix<OutputScalarT,EigenDim,Eigen::Dynamic> &poly_max,
+                                           const Eigen::Matrix<OutputScalarT,EigenDim,Eigen::Dynamic> &centers)
+        {
+            size_t node = bvh_nodes_.size();
+            bvh_nodes_.emplace_back(indices[begin], 0);
+            if (end - begin == 1) {
+                bvh_min_.col(node) = poly_min.col(indices[begin]);
+                bvh_max_.col(node) = poly_max.col(indices[begin]);
+                return node;
+            }
+
+            Eigen::Matrix<OutputScalarT,EigenDim,1> center_min(centers.col(indices[begin]));
+            Eigen::Matrix<OutputScalarT,EigenDim,1> center_max(centers.col(indices[begin]));
+            for (size_t i = begin + 1; i < end; i++) {
+                center_min = center_min.cwiseMin(centers.col(indices[i]));
+                center_max = center_max.cwiseMax(centers.col(indices[i]));
+            }
+            ptrdiff_t axis;
+            (center_max - center_min).maxCoeff(&axis);
+
+            size_t mid = begin + (end - begin)/2;
+            std::nth_element(indices.begin() + begin, indices.begin() + mid, indices.begin() + end, PolytopeCenterComparator_(centers, axis));
+            build_bounding_volume_node_(indices, begin, mid, poly_min, poly_max, centers);
+            size_t right = build_bounding_volume_node_(indices, mid, end, poly_min, poly_max, centers);
+
+            bvh_nodes_[node].right = right;
+            bvh_min_.col(node) = bvh_min_.col(node + 1).cwiseMin(bvh_min_.col(right));
+            bvh_max_.col(node) = bvh_max_.col(node + 1).cwiseMax(bvh_max_.col(right));
+            return node;
+        }
+
+        // Tests the polytopes of the leaves before node_end; descendants follow their node, so whole subtrees are
+        // skipped past it. The tree is balanced, so its depth is logarithmic in the number of polytopes.
+        bool bvh_contains_point_(const Eigen::Ref<const Eigen::Matrix<OutputScalarT,EigenDim,1> > &point, OutputScalarT offset, size_t node_end) const {
+            if (bvh_nodes_.empty()) return false;
+            size_t stack[64];
+            size_t stack_size = 0;
+            stack[stack_size++] = 0;
+            while (stack_size > 0) {
+                size_t n = stack[--stack_size];
+                if (n >= node_end) continue;
+                if ((point.array() < bvh_min_.col(n).array()).any() || (point.array() > bvh_max_.col(n).array()).any()) continue;
+                if (bvh_nodes_[n].right == 0) {
+                    if (polytopes_[bvh_nodes_[n].polytope].containsPoint(point, offset)) return true;
+                } else {
+                    stack[stack_size++] = bvh_nodes_[n].right;
+                    stack[stack_size++] = n + 1;
+                }
+            }
+            return false;
+        }
+
+        // Leaves from node_begin on whose boxes overlap the given one
+        void get_overlapping_leaves_(const Eigen::Ref<const Eigen::Matrix<OutputScalarT,EigenDim,1> > &box_min,
+                                     const Eigen::Ref<const Eigen::Matrix<OutputScalarT,EigenDim,1> > &box_max,
+                                     size_t node_begin, std::vector<size_t> &leaves) const
+        {
+            leaves.clear();
+            if (bvh_nodes_.empty()) return;
+            size_t stack[64];
+            size_t stack_size = 0;
+            stack[stack_size++] = 0;
+            while (stack_size > 0) {
+                size_t n = stack[--stack_size];
+                if ((box_min.array() > bvh_max_.col(n).array()).any() || (box_max.array() < bvh_min_.col(n).array()).any()) continue;
+                if (bvh_nodes_[n].right == 0) {
+                    if (n >= node_begin) leaves.emplace_back(n);
+                } else {
+                    if (bvh_nodes_[n].right > node_begin) stack[stack_size++] = n + 1;
+                    stack[stack_size++] = bvh_nodes_[n].right;
+                }
+            }
+        }
+
+        // Signed inclusion-exclusion sum over the subsets that extend that of intersection with candidate leaves from
+        // first on (in increasing order)
+        double get_intersection_volume_sum_(const ConvexPolytope<InputScalarT,OutputScalarT,EigenDim> &intersection,
+                                            const std::vector<size_t> &candidates, size_t first,
+                                            double merge_tol, double dist_tol) const
+        {
+            double volume = intersection.getVolume();
+            if (first == candidates.size()) return volume;
+
+            const PointMatrix<OutputScalarT,EigenDim>& vertices(intersection.getVertices());
+            Eigen::Matrix<OutputScalarT,EigenDim,1> box_min(vertices.rowwise().minCoeff());
+            Eigen::Matrix<OutputScalarT,EigenDim,1> box_max(vertices.rowwise().maxCoeff());
+            for (size_t c = first; c < candidates.size(); c++) {
+                size_t n = candidates[c];
+                if ((box_min.array() > bvh_max_.col(n).array()).any() || (box_max.array() < bvh_min_.col(n).array()).any()) continue;
+                ConvexPolytope<InputScalarT,OutputScalarT,EigenDim> next(intersection.intersectionWith(polytopes_[bvh_nodes_[n].polytope], false, false, merge_tol, dist_tol));
+                if (next.isEmpty() || !(next.getVolume() > 0.0) || next.getVertices().cols() == 0) continue;
+                volume -= get_intersection_volume_sum_(next, candidates, c + 1, merge_tol, dist_tol);
+            }
+            return volume;
+        }
     };
 
     typedef SpaceRegion<float,float,2> SpaceRegion2D;
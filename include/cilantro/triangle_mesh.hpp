@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cilantro/point_cloud.hpp>
+
+namespace cilantro {
+    // Triangles are stored as a flat array of vertex index triplets, counter-clockwise around the face normal
+    struct TriangleMesh {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        typedef Eigen::Matrix<size_t,3,1> Face;
+
+        TriangleMesh();
+        TriangleMesh(const std::vector<Eigen::Vector3f> &vertices, const std::vector<Face> &faces);
+        // Polygons are fan triangulated
+        TriangleMesh(const std::vector<Eigen::Vector3f> &vertices, const std::vector<std::vector<size_t> > &faces);
+        // Vertices, along with their normals and colors, are copied from the cloud
+        TriangleMesh(const PointCloud &cloud, const std::vector<Face> &faces);
+
+        std::vector<Eigen::Vector3f> vertices;
+        std::vector<Eigen::Vector3f> vertexNormals;
+        std::vector<Eigen::Vector3f> vertexColors;
+        std::vector<Face> faces;
+
+        inline size_t getNumberOfVertices() const { return vertices.size(); }
+        inline size_t getNumberOfFaces() const { return faces.size(); }
+        inline bool hasVertexNormals() const { return !vertices.empty() && vertexNormals.size() == vertices.size(); }
+        inline bool hasVertexColors() const { return !vertices.empty() && vertexColors.size() == vertices.size(); }
+        inline bool empty() const { return faces.empty(); }
+        TriangleMesh& clear();
+
+        TriangleMesh& append(const TriangleMesh &mesh);
+
+        // Drops vertices that no face refers to and renumbers the faces accordingly
+        TriangleMesh& removeUnreferencedVertices();
+        TriangleMesh& removeDegenerateFaces();
+
+        // Unit face normals
+        std::vector<Eigen::Vector3f> getFaceNormals() const;
+        std::vector<float> getFaceAreas() const;
+        // Area weighted average of the incident face normals
+        TriangleMesh& computeVertexNormals();
+
+        float getSurfaceArea() const;
+
+        PointCloud getVertexCloud() const;
+
+        // For interfaces that take per face index lists (e.g. Visualizer::addTriangleMesh)
+        std::vector<std::vector<size_t> > getFaceList() const;
+
+        inline Eigen::Map<Eigen::Matrix<float,3,Eigen::Dynamic> > verticesMatrixMap() { return Eigen::Map<Eigen::Matrix<float,3,Eigen::Dynamic> >((float *)vertices.data(), 3, vertices.size()); }
+        inline Eigen::Map<const Eigen::Matrix<float,3,Eigen::Dynamic> > verticesMatrixMap() const { return Eigen::Map<const Eigen::Matrix<float,3,Eigen::Dynamic> >((float *)vertices.data(), 3, vertices.size()); }
+
+        inline Eigen::Map<Eigen::Matrix<size_t,3,Eigen::Dynamic> > facesMatrixMap() { return Eigen::Map<Eigen::Matrix<size_t,3,Eigen::Dynamic> >((size_t *)faces.data(), 3, faces.size()); }
+        inline Eigen::Map<const Eigen::Matrix<size_t,3,Eigen::Dynamic> > facesMatrixMap() const { return Eigen::Map<const Eigen::Matrix<size_t,3,Eigen::Dynamic> >((size_t *)faces.data(), 3, faces.size()); }
+    };
+
+    // Incidence and adjacency of a mesh's faces, in compressed (offset/index array) form. Edge k of a face goes from
+    // its k-th to its (k+1)%3-th vertex.
+    class TriangleMeshTopology {
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        TriangleMeshTopology(const TriangleMesh &mesh);
+
+        ~TriangleMeshTopology() {}
+
+        // Faces around vertex v are getVertexFaces()[getVertexFaceOffsets()[v]] to
+        // getVertexFaces()[getVertexFaceOffsets()[v+1]-1]
+        inline const std::vector<size_t>& getVertexFaceOffsets() const { return vertex_face_offsets_; }
+        inline const std::vector<size_t>& getVertexFaces() const { return vertex_faces_; }
+
+        inline size_t getNumberOfVertexFaces(size_t vertex_ind) const { return vertex_face_offsets_[vertex_ind+1] - vertex_face_offsets_[vertex_ind]; }
+
+        // Face across each edge; getNoFace() for boundary and non-manifold edges
+        inline const std::vector<TriangleMesh::Face>& getFaceNeighbors() const { return face_neighbors_; }
+
+        static inline size_t getNoFace() { return std::numeric_limits<size_t>::max(); }
+
+        inline size_t getNumberOfBoundaryEdges() const { return num_boundary_edges_; }
+        // Counted once per incident face
+        inline size_t getNumberOfNonManifoldEdges() const { return num_non_manifold_edges_; }
+
+        // Edge manifold without boundary
+        inline bool isClosed() const { return num_boundary_edges_ == 0 && num_non_manifold_edges_ == 0; }
+
+    private:
+        std::vector<size_t> vertex_face_offsets_;
+        std::vector<size_t> vertex_faces_;
+        std::vector<TriangleMesh::Face> face_neighbors_;
+        size_t num_boundary_edges_;
+        size_t num_non_manifold_edges_;
+    };
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <deque>
+#include <unordered_map>
+#include <cilantro/cartesian_grid.hpp>
+#include <cilantro/point_cloud.hpp>
+#include <pangolin/pangolin.h>
+
+namespace cilantro {
+    // Signed distances are stored normalized by the truncation distance, i.e. in [-1,1]
+    struct TSDFVoxel {
+        float sdf;
+        float weight;
+        Eigen::Matrix<unsigned char,3,1> color;
+    };
+
+    // Sparse truncated signed distance volume. Voxels are grouped in blocks of 8x8x8 that are allocated around observed
+    // surfaces only and looked up by their grid coordinates through a hash map. Camera poses (rot_mat, t_vec) map world
+    // coordinates to the camera frame, as in pointsToDepthImage.
+    class TSDFVolume {
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        enum { BlockResolution = 8, BlockVolume = 512 };
+
+        typedef Eigen::Matrix<ptrdiff_t,3,1> GridCoordinates;
+
+        struct VoxelBlock {
+            GridCoordinates coordinates;
+            TSDFVoxel voxels[BlockVolume];
+        };
+
+        TSDFVolume(float voxel_size, float truncation_distance, float max_weight = 128.0f);
+
+        ~TSDFVolume() {}
+
+        inline float getVoxelSize() const { return voxel_size_; }
+        inline float getTruncationDistance() const { return truncation_distance_; }
+
+        inline float getMaxWeight() const { return max_weight_; }
+        inline TSDFVolume& setMaxWeight(float max_weight) { max_weight_ = max_weight; return *this; }
+
+        // Depth values are multiplied by depth_scale to get meters; farther measurements are not integrated
+        inline float getDepthScale() const { return depth_scale_; }
+        inline TSDFVolume& setDepthScale(float depth_scale) { depth_scale_ = depth_scale; return *this; }
+
+        inline float getMaxDepth() const { return max_depth_; }
+        inline TSDFVolume& setMaxDepth(float max_depth) { max_depth_ = max_depth; return *this; }
+
+        inline bool hasColors() const { return has_colors_; }
+
+        inline size_t getNumberOfBlocks() const { return blocks_.size(); }
+        inline const std::deque<VoxelBlock>& getBlocks() const { return blocks_; }
+
+        TSDFVolume& clear();
+
+        TSDFVolume& integrate(const pangolin::Image<unsigned short> &depth_img,
+                              const Eigen::Matrix3f &intrinsics,
+                              const Eigen::Matrix3f &rot_mat = Eigen::Matrix3f::Identity(),
+                              const Eigen::Vector3f &t_vec = Eigen::Vector3f::Zero());
+
+        TSDFVolume& integrate(const pangolin::Image<Eigen::Matrix<unsigned char,3,1> > &rgb_img,
+                              const pangolin::Image<unsigned short> &depth_img,
+                              const Eigen::Matrix3f &intrinsics,
+                              const Eigen::Matrix3f &rot_mat = Eigen::Matrix3f::Identity(),
+                              const Eigen::Vector3f &t_vec = Eigen::Vector3f::Zero());
+
+        // Renders the model's zero level set into a (preallocated) depth map; pixels whose rays miss it are set to 0
+        void raycast(pangolin::Image<unsigned short> &depth_img,
+                     const Eigen::Matrix3f &intrinsics,
+                     const Eigen::Matrix3f &rot_mat = Eigen::Matrix3f::Identity(),
+                     const Eigen::Vector3f &t_vec = Eigen::Vector3f::Zero()) const;
+
+        void raycast(pangolin::Image<Eigen::Matrix<unsigned char,3,1> > &rgb_img,
+                     pangolin::Image<unsigned short> &depth_img,
+                     const Eigen::Matrix3f &intrinsics,
+                     const Eigen::Matrix3f &rot_mat = Eigen::Matrix3f::Identity(),
+                     const Eigen::Vector3f &t_vec = Eigen::Vector3f::Zero()) const;
+
+        // Trilinear interpolation; fails if any of the 8 surrounding voxels is unobserved
+        bool getSDF(const Eigen::Vector3f &point, float &sdf) const;
+
+        bool getSDFGradient(const Eigen::Vector3f &point, Eigen::Vector3f &gradient) const;
+
+        const TSDFVoxel* getVoxel(const GridCoordinates &voxel_coords) const;
+
+        // Zero crossings between neighboring voxels, with normals from the SDF gradient
+        PointCloud extractPointCloud(float min_weight = 0.0f) const;
+
+        // Marching cubes over the observed voxels (see marchingCubes)
+        void extractMesh(std::vector<Eigen::Vector3f> &vertices,
+                         std::vector<std::vector<size_t> > &faces,
+                         float min_weight = 0.0f) const;
+
+        void extractMesh(std::vector<Eigen::Vector3f> &vertices,
+                         std::vector<std::vector<size_t> > &faces,
+                         std::vector<Eigen::Vector3f> &vertex_colors,
+                         float min_weight = 0.0f) const;
+
+    private:
+        float voxel_size_;
+        float truncation_distance_;
+        float max_weight_;
+        float depth_scale_;
+        float max_depth_;
+        bool has_colors_;
+
+        // Remembers the last block looked up along with the neighbors queried so far, as consecutive queries mostly
+        // fall in the same block
+        struct BlockCache {
+            inline BlockCache() : looked_up(0), valid(false) {}
+            GridCoordinates coordinates;
+            const VoxelBlock *blocks[8];
+            size_t looked_up;
+            bool valid;
+        };
+
+        std::deque<VoxelBlock> blocks_;
+        std::unordered_map<GridCoordinates,size_t,EigenVectorHash<ptrdiff_t,3> > block_lookup_table_;
+
+        void integrate_(const pangolin::Image<Eigen::Matrix<unsigned char,3,1> > *rgb_img,
+                        const pangolin::Image<unsigned short> &depth_img,
+                        const Eigen::Matrix3f &intrinsics,
+                        const Eigen::Matrix3f &rot_mat,
+                        const Eigen::Vector3f &t_vec);
+
+        void raycast_(pangolin::Image<Eigen::Matrix<unsigned char,3,1> > *rgb_img,
+                      pangolin::Image<unsigned short> &depth_img,
+                      const Eigen::Matrix3f &intrinsics,
+                      const Eigen::Matrix3f &rot_mat,
+                      const Eigen::Vector3f &t_vec) const;
+
+        void extract_mesh_(std::vector<Eigen::Vector3f> &vertices,
+                           std::vector<std::vector<size_t> > &faces,
+                           std::vector<Eigen::Vector3f> *vertex_colors,
+                           float min_weight) const;
+
+        const VoxelBlock* find_block_(const GridCoordinates &block_coords, BlockCache &cache) const;
+
+        const TSDFVoxel* get_voxel_(const GridCoordinates &voxel_coords, BlockCache &cache) const;
+
+        // Blocks at block_coords plus each offset in {0,1}^3 (indexed by its bits) that is a subset of offset_mask (bit
+        // i for axis i); other entries are unspecified
+        const VoxelBlock* const* get_neighbor_blocks_(const GridCoordinates &block_coords, size_t offset_mask, BlockCache &cache) const;
+
+        bool interpolate_(const Eigen::Vector3f &point, float &sdf, Eigen::Vector3f *color, BlockCache &cache) const;
+
+        bool sdf_gradient_(const Eigen::Vector3f &point, Eigen::Vector3f &gradient, BlockCache &cache) const;
+    };
+}
@@ -0,0 +1,247 @@
+#include <cilantro/ball_pivoting.hpp>
+#include <unordered_map>
+
+namespace cilantro {
+    namespace {
+        // Front edges are ACTIVE (still to be pivoted on) or BOUNDARY (pivoting failed); INNER edges are shared by two
+        // faces
+        enum struct EdgeState {ACTIVE, BOUNDARY, INNER};
+
+        // Directed edge of the face (source, target, opposite), with the center of the ball that touches its vertices
+        struct MeshEdge {
+            EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+            inline MeshEdge(size_t source, size_t target, size_t opposite, const Eigen::Vector3f &center, EdgeState state)
+                    : source(source), target(target), opposite(opposite), center(center), state(state)
+            {}
+
+            size_t source;
+            size_t target;
+            size_t opposite;
+            Eigen::Vector3f center;
+            EdgeState state;
+        };
+
+        // Writes the indices of the points within radius to a preallocated buffer
+        struct NeighborWriter {
+            inline NeighborWriter(size_t *neighbors, size_t capacity, float radius)
+                    : neighbors(neighbors), capacity(capacity), count(0), radius(radius)
+            {}
+
+            inline bool addPoint(float, size_t ind) {
+                if (count < capacity) neighbors[count++] = ind;
+                return count < capacity;
+            }
+            inline float worstDist() const { return radius; }
+            inline bool full() const { return true; }
+
+            size_t *neighbors;
+            size_t capacity;
+            size_t count;
+            float radius;
+        };
+
+        class BallPivoter {
+        public:
+            BallPivoter(const PointCloud &cloud, const KDTree3D &kd_tree, float ball_radius)
+                    : points_(cloud.points),
+                      normals_(cloud.normals),
+                      radius_(ball_radius),
+                      radius_sq_(ball_radius*ball_radius),
+                      used_(cloud.size(), false),
+                      front_count_(cloud.size(), 0)
+            {
+                compute_neighborhoods_(kd_tree);
+            }
+
+            std::vector<TriangleMesh::Face> reconstruct() {
+                for (size_t i = 0; i < points_.size(); i++) {
+                    if (used_[i] || !find_seed_(i)) continue;
+                    expand_front_();
+                }
+                return std::move(faces_);
+            }
+
+        private:
+            const std::vector<Eigen::Vector3f> &points_;
+            const std::vector<Eigen::Vector3f> &normals_;
+            float radius_;
+            float radius_sq_;
+
+            // Points within twice the ball radius, i.e. all that a ball touching the point can reach
+            std::vector<size_t> neighbor_offsets_;
+            std::vector<size_t> neighbors_;
+
+            std::vector<bool> used_;
+            std::vector<size_t> front_count_;
+            std::vector<MeshEdge,Eigen::aligned_allocator<MeshEdge> > edges_;
+            std::unordered_map<size_t,size_t> edge_lookup_;
+            std::vector<size_t> front_;
+            std::vector<TriangleMesh::Face> faces_;
+
+            void compute_neighborhoods_(const KDTree3D &kd_tree) {
+                size_t num_points = points_.size();
+                float search_radius_sq = 4.0f*radius_sq_;
+
+                neighbor_offsets_.resize(num_points + 1);
+                neighbor_offsets_[0] = 0;
+#pragma omp parallel for schedule (dynamic, 256)
+                for (size_t i = 0; i < num_points; i++) {
+                    neighbor_offsets_[i+1] = kd_tree.radiusCount(points_[i], search_radius_sq);
+                }
+                for (size_t i = 0; i < num_points; i++) {
+                    neighbor_offsets_[i+1] += neighbor_offsets_[i];
+                }
+
+                neighbors_.resize(neighbor_offsets_[num_points]);
+#pragma omp parallel for schedule (dynamic, 256)
+                for (size_t i = 0; i < num_points; i++) {
+                    NeighborWriter writer(neighbors_.data() + neighbor_offsets_[i], neighbor_offsets_[i+1] - neighbor_offsets_[i], search_radius_sq);
+                    if (writer.capacity > 0) kd_tree.findNeighbors(points_[i], writer);
+                }
+            }
+
+            inline size_t edge_key_(size_t source, size_t target) const {
+                return source*points_.size() + target;
+            }
+
+            inline const MeshEdge* find_edge_(size_t source, size_t target) const {
+                auto it = edge_lookup_.find(edge_key_(source, target));
+                return (it == edge_lookup_.end()) ? NULL : &edges_[it->second];
+            }
+
+            // Center of the ball touching the counter-clockwise triangle (v0, v1, v2), on the side its normal points to
+            bool get_ball_center_(size_t v0, size_t v1, size_t v2, Eigen::Vector3f &center) const {
+                const Eigen::Vector3f& p0(points_[v0]);
+                Eigen::Vector3f d1(points_[v1] - p0), d2(points_[v2] - p0);
+                Eigen::Vector3f normal(d1.cross(d2));
+                float normal_sq_norm = normal.squaredNorm();
+                if (normal_sq_norm < std::numeric_limits<float>::epsilon()*d1.squaredNorm()*d2.squaredNorm()) return false;
+                // Consistent with the point normals
+                if (normal.dot(normals_[v0] + normals_[v1] + normals_[v2]) <= 0.0f) return false;
+
+                Eigen::Vector3f circumcenter_offset((d1.squaredNorm()*d2 - d2.squaredNorm()*d1).cross(normal)/(2.0f*normal_sq_norm));
+                float height_sq = radius_sq_ - circumcenter_offset.squaredNorm();
+                if (height_sq < 0.0f) return false;
+
+                center = p0 + circumcenter_offset + std::sqrt(height_sq/normal_sq_norm)*normal;
+                return true;
+            }
+
+            bool is_ball_empty_(const Eigen::Vector3f &center, size_t v0, size_t v1, size_t v2) const {
+                float threshold = radius_sq_*(1.0f - 1e-5f);
+                for (size_t j = neighbor_offsets_[v0]; j < neighbor_offsets_[v0+1]; j++) {
+                    size_t k = neighbors_[j];
+                    if (k == v0 || k == v1 || k == v2) continue;
+                    if ((points_[k] - center).squaredNorm() < threshold) return false;
+                }
+                return true;
+            }
+
+            void add_edge_(size_t source, size_t target, size_t opposite, const Eigen::Vector3f &center) {
+                auto it = edge_lookup_.find(edge_key_(target, source));
+                if (it != edge_lookup_.end() && edges_[it->second].state != EdgeState::INNER) {
+                    // Glue to the reverse front edge
+                    edges_[it->second].state = EdgeState::INNER;
+                    front_count_[source]--;
+                    front_count_[target]--;
+                    edge_lookup_[edge_key_(source, target)] = edges_.size();
+                    edges_.emplace_back(source, target, opposite, center, EdgeState::INNER);
+                    return;
+                }
+                edge_lookup_[edge_key_(source, target)] = edges_.size();
+                front_.emplace_back(edges_.size());
+                edges_.emplace_back(source, target, opposite, center, EdgeState::ACTIVE);
+                front_count_[source]++;
+                front_count_[target]++;
+            }
+
+            void add_face_(size_t v0, size_t v1, size_t v2, const Eigen::Vector3f &center) {
+                faces_.emplace_back(v0, v1, v2);
+                used_[v0] = used_[v1] = used_[v2] = true;
+                add_edge_(v0, v1, v2, center);
+                add_edge_(v1, v2, v0, center);
+                add_edge_(v2, v0, v1, center);
+            }
+
+            bool find_seed_(size_t v0) {
+                Eigen::Vector3f center;
+                for (size_t j1 = neighbor_offsets_[v0]; j1 < neighbor_offsets_[v0+1]; j1++) {
+                    size_t v1 = neighbors_[j1];
+                    if (v1 == v0 || used_[v1]) continue;
+                    for (size_t j2 = j1 + 1; j2 < neighbor_offsets_[v0+1]; j2++) {
+                        size_t v2 = neighbors_[j2];
+                        if (v2 == v0 || used_[v2]) continue;
+                        size_t a = v1, b = v2;
+                        if ((points_[a] - points_[v0]).cross(points_[b] - points_[v0]).dot(normals_[v0]) < 0.0f) std::swap(a, b);
+                        if (!get_ball_center_(v0, a, b, center) || !is_ball_empty_(center, v0, a, b)) continue;
+                        add_face_(v0, a, b, center);
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            // Rotates the ball of a front edge around it, away from its face, until it touches another point
+            void pivot_(size_t edge_ind) {
+                size_t source = edges_[edge_ind].source;
+                size_t target = edges_[edge_ind].target;
+                size_t opposite = edges_[edge_ind].opposite;
+
+                Eigen::Vector3f midpoint(0.5f*(points_[source] + points_[target]));
+                Eigen::Vector3f axis((points_[target] - points_[source]).normalized());
+                Eigen::Vector3f from_center(edges_[edge_ind].center - midpoint);
+
+                const float two_pi = 6.28318530718f;
+                float best_angle = std::numeric_limits<float>::infinity();
+                size_t best = 0;
+                Eigen::Vector3f best_center, center;
+                for (size_t j = neighbor_offsets_[source]; j < neighbor_offsets_[source+1]; j++) {
+                    size_t k = neighbors_[j];
+                    if (k == source || k == target || k == opposite) continue;
+                    if (!get_ball_center_(target, source, k, center)) continue;
+                    Eigen::Vector3f to_center(center - midpoint);
+                    float angle = std::atan2(axis.dot(from_center.cross(to_center)), from_center.dot(to_center));
+                    if (angle < 0.0f) angle += two_pi;
+                    // Points on the current ball's sphere are touched right away
+                    if (angle > two_pi - 1e-4f) angle = 0.0f;
+                    if (angle < best_angle) {
+                        best_angle = angle;
+                        best = k;
+                        best_center = center;
+                    }
+                }
+
+                if (best_angle == std::numeric_limits<float>::infinity() ||
+                    (used_[best] && front_count_[best] == 0) ||
+                    find_edge_(source, best) != NULL || find_edge_(best, target) != NULL)
+                {
+                    edges_[edge_ind].state = EdgeState::BOUNDARY;
+                    return;
+                }
+
+                add_face_(target, source, best, best_center);
+            }
+
+            void expand_front_() {
+                while (!front_.empty()) {
+                    size_t edge_ind = front_.back();
+                    front_.pop_back();
+                    if (edges_[edge_ind].state != EdgeState::ACTIVE) continue;
+                    pivot_(edge_ind);
+                }
+            }
+        };
+    }
+
+    TriangleMesh ballPivotingReconstruction(const PointCloud &cloud, float ball_radius) {
+        KDTree3D kd_tree(cloud.points);
+        return ballPivotingReconstruction(cloud, kd_tree, ball_radius);
+    }
+
+    TriangleMesh ballPivotingReconstruction(const PointCloud &cloud, const KDTree3D &kd_tree, float ball_radius) {
+        if (!cloud.hasNormals() || ball_radius <= 0.0f) return TriangleMesh(cloud, std::vector<TriangleMesh::Face>());
+        BallPivoter pivoter(cloud, kd_tree, ball_radius);
+        return TriangleMesh(cloud, pivoter.reconstruct());
+    }
+}
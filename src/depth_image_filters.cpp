@@ -0,0 +1,213 @@
+#include <cilantro/depth_image_filters.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace cilantro {
+    namespace {
+        void copyDepthImage(const pangolin::Image<unsigned short> &depth_img, std::vector<unsigned short> &copy) {
+            copy.resize(depth_img.w*depth_img.h);
+#pragma omp parallel for
+            for (size_t y = 0; y < depth_img.h; y++) {
+                std::copy(depth_img.RowPtr(y), depth_img.RowPtr(y) + depth_img.w, copy.data() + y*depth_img.w);
+            }
+        }
+
+        inline void sortPair(unsigned short &a, unsigned short &b) {
+            unsigned short lo = std::min(a, b);
+            b = std::max(a, b);
+            a = lo;
+        }
+
+        // Branchless median of 9 (Paeth's exchange network)
+        inline unsigned short median9(unsigned short * p) {
+            sortPair(p[1], p[2]); sortPair(p[4], p[5]); sortPair(p[7], p[8]);
+            sortPair(p[0], p[1]); sortPair(p[3], p[4]); sortPair(p[6], p[7]);
+            sortPair(p[1], p[2]); sortPair(p[4], p[5]); sortPair(p[7], p[8]);
+            sortPair(p[0], p[3]); sortPair(p[5], p[8]); sortPair(p[4], p[7]);
+            sortPair(p[3], p[6]); sortPair(p[1], p[4]); sortPair(p[2], p[5]);
+            sortPair(p[4], p[7]); sortPair(p[4], p[2]); sortPair(p[6], p[4]);
+            sortPair(p[4], p[2]);
+            return p[4];
+        }
+
+        inline unsigned short selectMedian(unsigned short * vals, size_t num) {
+            if (num == 9) return median9(vals);
+            std::nth_element(vals, vals + num/2, vals + num);
+            return vals[num/2];
+        }
+
+        // One bilateral pass along rows or columns of a dense buffer; contributions are accumulated one kernel tap at a
+        // time over whole rows, so inner loops run over contiguous pixels
+        void bilateralPass(const unsigned short * src,
+                           size_t w, size_t h,
+                           bool vertical,
+                           const std::vector<float> &spatial_weights,
+                           const std::vector<float> &range_weights,
+                           unsigned short * dst)
+        {
+            const long radius = spatial_weights.size() - 1;
+            const int max_diff = range_weights.size() - 1;
+            const float * range_lut = range_weights.data();
+
+#pragma omp parallel
+            {
+                std::vector<float> sum(w), weight_sum(w);
+#pragma omp for
+                for (size_t y = 0; y < h; y++) {
+                    const unsigned short * center = src + y*w;
+                    std::fill(sum.begin(), sum.end(), 0.0f);
+                    std::fill(weight_sum.begin(), weight_sum.end(), 0.0f);
+                    for (long o = -radius; o <= radius; o++) {
+                        const float spatial = spatial_weights[std::abs(o)];
+                        size_t x_begin = 0, x_end = w;
+                        const unsigned short * neighbor;
+                        if (vertical) {
+                            if ((long)y + o < 0 || (long)y + o >= (long)h) continue;
+                            neighbor = src + (y + o)*w;
+                        } else {
+                            x_begin = std::max(-o, 0L);
+                            x_end = std::min((long)w - o, (long)w);
+                            if (x_begin >= x_end) continue;
+                            neighbor = center + o;
+                        }
+                        for (size_t x = x_begin; x < x_end; x++) {
+                            const int dk = neighbor[x];
+                            const int diff = std::min(std::abs(dk - (int)center[x]), max_diff);
+                            const float weight = (float)(dk != 0)*spatial*range_lut[diff];
+                            sum[x] += weight*dk;
+                            weight_sum[x] += weight;
+                        }
+                    }
+                    unsigned short * dst_row = dst + y*w;
+                    for (size_t x = 0; x < w; x++) {
+                        dst_row[x] = (center[x] != 0) ? (unsigned short)(sum[x]/weight_sum[x] + 0.5f) : 0;
+                    }
+                }
+            }
+        }
+    }
+
+    void bilateralFilterDepthImage(pangolin::Image<unsigned short> &depth_img,
+                                   size_t radius,
+                                   float sigma_spatial,
+                                   float sigma_depth)
+    {
+        if (!depth_img.ptr || radius == 0 || sigma_spatial <= 0.0f || sigma_depth <= 0.0f) return;
+
+        std::vector<float> spatial_weights(radius + 1);
+        for (size_t k = 0; k <= radius; k++) {
+            spatial_weights[k] = std::exp(-0.5f*k*k/(sigma_spatial*sigma_spatial));
+        }
+        // Range kernel lookup table over integer depth differences, truncated at 3 sigma (the last entry is zero and
+        // absorbs all larger differences)
+        std::vector<float> range_weights((size_t)std::ceil(3.0f*sigma_depth) + 2, 0.0f);
+        for (size_t k = 0; k + 1 < range_weights.size(); k++) {
+            range_weights[k] = std::exp(-0.5f*k*k/(sigma_depth*sigma_depth));
+        }
+
+        const size_t w = depth_img.w, h = depth_img.h;
+        std::vector<unsigned short> src, tmp(w*h);
+        copyDepthImage(depth_img, src);
+        bilateralPass(src.data(), w, h, false, spatial_weights, range_weights, tmp.data());
+        bilateralPass(tmp.data(), w, h, true, spatial_weights, range_weights, src.data());
+
+#pragma omp parallel for
+        for (size_t y = 0; y < h; y++) {
+            std::copy(src.data() + y*w, src.data() + (y + 1)*w, depth_img.RowPtr(y));
+        }
+    }
+
+    void medianFilterDepthImage(pangolin::Image<unsigned short> &depth_img, size_t radius) {
+        if (!depth_img.ptr || radius == 0) return;
+
+        const size_t w = depth_img.w, h = depth_img.h;
+        const long r = radius;
+        std::vector<unsigned short> src;
+        copyDepthImage(depth_img, src);
+
+#pragma omp parallel
+        {
+            std::vector<unsigned short> window((2*radius + 1)*(2*radius + 1));
+            std::vector<unsigned short> row_medians((r == 1) ? w : 0);
+#pragma omp for
+            for (size_t y = 0; y < h; y++) {
+                unsigned short * dst_row = depth_img.RowPtr(y);
+                const unsigned short * src_row = src.data() + y*w;
+                const bool interior_row = r == 1 && y > 0 && y + 1 < h && w > 2;
+
+                // 3x3 medians of all interior pixels in one branch-free (vectorizable) sweep; windows containing
+                // invalid pixels are redone below
+                if (interior_row) {
+                    for (size_t x = 1; x + 1 < w; x++) {
+                        const unsigned short * c = src_row + x;
+                        unsigned short p[9] = {c[-(long)w - 1], c[-(long)w], c[-(long)w + 1], c[-1], c[0], c[1], c[w - 1], c[w], c[w + 1]};
+                        row_medians[x] = median9(p);
+                    }
+                }
+
+                const long y_min = std::max((long)y - r, 0L), y_max = std::min((long)y + r, (long)h - 1);
+                for (size_t x = 0; x < w; x++) {
+                    if (src_row[x] == 0) continue;
+                    if (interior_row && x > 0 && x + 1 < w) {
+                        const unsigned short * c = src_row + x;
+                        if (c[-(long)w - 1] && c[-(long)w] && c[-(long)w + 1] && c[-1] && c[1] && c[w - 1] && c[w] && c[w + 1]) {
+                            dst_row[x] = row_medians[x];
+                            continue;
+                        }
+                    }
+                    const long x_min = std::max((long)x - r, 0L), x_max = std::min((long)x + r, (long)w - 1);
+                    size_t num = 0;
+                    for (long yy = y_min; yy <= y_max; yy++) {
+                        const unsigned short * window_row = src.data() + yy*w;
+                        for (long xx = x_min; xx <= x_max; xx++) {
+                            window[num] = window_row[xx];
+                            num += window_row[xx] != 0;
+                        }
+                    }
+                    dst_row[x] = selectMedian(window.data(), num);
+                }
+            }
+        }
+    }
+
+    void removeDepthImageJumpEdges(pangolin::Image<unsigned short> &depth_img, float max_jump_ratio, size_t radius) {
+        if (!depth_img.ptr || radius == 0 || max_jump_ratio <= 0.0f) return;
+
+        const size_t w = depth_img.w, h = depth_img.h;
+        const long r = radius;
+        std::vector<unsigned short> src;
+        copyDepthImage(depth_img, src);
+
+#pragma omp parallel
+        {
+            std::vector<int> max_jump(w);
+#pragma omp for
+            for (size_t y = 0; y < h; y++) {
+                const unsigned short * center = src.data() + y*w;
+                std::fill(max_jump.begin(), max_jump.end(), 0);
+                const long y_min = std::max((long)y - r, 0L), y_max = std::min((long)y + r, (long)h - 1);
+                for (long yy = y_min; yy <= y_max; yy++) {
+                    for (long o = -r; o <= r; o++) {
+                        const size_t x_begin = std::max(-o, 0L), x_end = std::min((long)w - o, (long)w);
+                        const unsigned short * neighbor = src.data() + yy*w + o;
+                        for (size_t x = x_begin; x < x_end; x++) {
+                            const int diff = (neighbor[x] != 0) ? std::abs((int)neighbor[x] - (int)center[x]) : 0;
+                            max_jump[x] = std::max(max_jump[x], diff);
+                        }
+                    }
+                }
+                unsigned short * dst_row = depth_img.RowPtr(y);
+                for (size_t x = 0; x < w; x++) {
+                    if (max_jump[x] > (int)(max_jump_ratio*center[x])) dst_row[x] = 0;
+                }
+            }
+        }
+    }
+
+    void filterDepthImage(pangolin::Image<unsigned short> &depth_img, const DepthImageFilterParameters &params) {
+        medianFilterDepthImage(depth_img, params.medianRadius);
+        bilateralFilterDepthImage(depth_img, params.bilateralRadius, params.bilateralSigmaSpatial, params.bilateralSigmaDepth);
+        removeDepthImageJumpEdges(depth_img, params.maxJumpRatio, params.jumpEdgeRadius);
+    }
+}
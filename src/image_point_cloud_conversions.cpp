@@ -1,6 +1,407 @@
 #include <cilantro/image_point_cloud_conversions.hpp>
+#include <atomic>
+#include <cstring>
 
 namespace cilantro {
+    LensDistortion::LensDistortion()
+            : model(Model::NONE),
+              coefficients(Eigen::Matrix<float,5,1>::Zero())
+    {}
+
+    LensDistortion::LensDistortion(const Model &model, const Eigen::Matrix<float,5,1> &coefficients)
+            : model(model),
+              coefficients(coefficients)
+    {}
+
+    Eigen::Vector2f LensDistortion::distort(const Eigen::Vector2f &point) const {
+        const Eigen::Matrix<float,5,1> &k = coefficients;
+        switch (model) {
+            case Model::RADIAL_TANGENTIAL: {
+                float x = point(0), y = point(1);
+                float r2 = x*x + y*y;
+                float radial = 1.0f + r2*(k(0) + r2*(k(1) + r2*k(4)));
+                return Eigen::Vector2f(x*radial + 2.0f*k(2)*x*y + k(3)*(r2 + 2.0f*x*x),
+                                       y*radial + k(2)*(r2 + 2.0f*y*y) + 2.0f*k(3)*x*y);
+            }
+            case Model::FISHEYE: {
+                float r = point.norm();
+                if (r < std::numeric_limits<float>::epsilon()) return point;
+                float theta = std::atan(r);
+                float theta2 = theta*theta;
+                float theta_d = theta*(1.0f + theta2*(k(0) + theta2*(k(1) + theta2*(k(2) + theta2*k(3)))));
+                return point*(theta_d/r);
+            }
+            default:
+                return point;
+        }
+    }
+
+    Eigen::Vector2f LensDistortion::undistort(const Eigen::Vector2f &point, size_t max_iter) const {
+        const Eigen::Matrix<float,5,1> &k = coefficients;
+        switch (model) {
+            case Model::RADIAL_TANGENTIAL: {
+                // Fixed point iteration on the radial factor and tangential offset
+                Eigen::Vector2f p(point);
+                for (size_t i = 0; i < max_iter; i++) {
+                    float x = p(0), y = p(1);
+                    float r2 = x*x + y*y;
+                    float radial = 1.0f + r2*(k(0) + r2*(k(1) + r2*k(4)));
+                    Eigen::Vector2f tangential(2.0f*k(2)*x*y + k(3)*(r2 + 2.0f*x*x), k(2)*(r2 + 2.0f*y*y) + 2.0f*k(3)*x*y);
+                    p = (point - tangential)/radial;
+                }
+                return p;
+            }
+            case Model::FISHEYE: {
+                // Newton iterations on theta_d = theta*(1 + k1*theta^2 + ... + k4*theta^8)
+                float theta_d = point.norm();
+                if (theta_d < std::numeric_limits<float>::epsilon()) return point;
+                float theta = theta_d;
+                for (size_t i = 0; i < max_iter; i++) {
+                    float theta2 = theta*theta;
+                    float f = theta*(1.0f + theta2*(k(0) + theta2*(k(1) + theta2*(k(2) + theta2*k(3))))) - theta_d;
+                    float df = 1.0f + theta2*(3.0f*k(0) + theta2*(5.0f*k(1) + theta2*(7.0f*k(2) + 9.0f*theta2*k(3))));
+                    float step = f/df;
+                    theta -= step;
+                    if (std::abs(step) < 1e-7f) break;
+                }
+                // Rays at or beyond 90 degrees cannot be expressed in normalized coordinates
+                if (!(theta >= 0.0f && theta < 0.5f*(float)M_PI)) {
+                    return Eigen::Vector2f::Constant(std::numeric_limits<float>::quiet_NaN());
+                }
+                return point*(std::tan(theta)/theta_d);
+            }
+            default:
+                return point;
+        }
+    }
+
+    namespace {
+        void computePinholeRays(size_t width, size_t height, const Eigen::Matrix3f &intr, std::vector<float> &x_rays, std::vector<float> &y_rays) {
+            x_rays.resize(width);
+            y_rays.resize(height);
+            float fx_inv = 1.0f/intr(0,0), fy_inv = 1.0f/intr(1,1);
+            for (size_t x = 0; x < width; x++) x_rays[x] = (x - intr(0,2))*fx_inv;
+            for (size_t y = 0; y < height; y++) y_rays[y] = (y - intr(1,2))*fy_inv;
+        }
+
+        // Pixels whose rays cannot be undistorted (e.g. fisheye rays at or beyond 90 degrees) are marked invalid and
+        // get zero rays
+        void computeUndistortedRays(size_t width, size_t height, const Eigen::Matrix3f &intr, const LensDistortion &distortion, std::vector<float> &x_rays, std::vector<float> &y_rays, std::vector<unsigned char> &valid_rays) {
+            x_rays.resize(width*height);
+            y_rays.resize(width*height);
+            valid_rays.resize(width*height);
+            float fx_inv = 1.0f/intr(0,0), fy_inv = 1.0f/intr(1,1);
+#pragma omp parallel for
+            for (size_t y = 0; y < height; y++) {
+                for (size_t x = 0; x < width; x++) {
+                    Eigen::Vector2f ray = distortion.undistort(Eigen::Vector2f((x - intr(0,2))*fx_inv, (y - intr(1,2))*fy_inv));
+                    bool valid = std::isfinite(ray(0)) && std::isfinite(ray(1));
+                    x_rays[y*width + x] = (valid) ? ray(0) : 0.0f;
+                    y_rays[y*width + x] = (valid) ? ray(1) : 0.0f;
+                    valid_rays[y*width + x] = valid;
+                }
+            }
+        }
+
+        // Rows are processed in parallel; output offsets come from a prefix sum over per-row valid pixel counts. Per
+        // pixel rays come with a validity mask; invalid pixels (by depth or ray) are kept as zero points if requested.
+        template <bool PerPixelRays>
+        void backProjectDepthImage(const pangolin::Image<unsigned short> &depth_img,
+                                   const pangolin::Image<Eigen::Matrix<unsigned char,3,1> > * rgb_img,
+                                   const float * x_rays,
+                                   const float * y_rays,
+                                   const unsigned char * valid_rays,
+                                   float depth_scale, float min_depth, float max_depth,
+                                   bool keep_invalid,
+                                   std::vector<Eigen::Vector3f> &points,
+                                   std::vector<Eigen::Vector3f> * colors)
+        {
+            const size_t w = depth_img.w, h = depth_img.h;
+            const unsigned short d_min = (unsigned short)std::min(std::max(std::ceil(min_depth/depth_scale), 1.0f), 65535.0f);
+            const unsigned short d_max = (unsigned short)std::min(std::max(std::floor(max_depth/depth_scale), 0.0f), 65535.0f);
+
+            std::vector<size_t> row_offsets(h + 1);
+            row_offsets[0] = 0;
+            if (keep_invalid) {
+                for (size_t y = 0; y < h; y++) row_offsets[y + 1] = (y + 1)*w;
+            } else {
+#pragma omp parallel for
+                for (size_t y = 0; y < h; y++) {
+                    const unsigned short * depth_row = depth_img.RowPtr(y);
+                    const unsigned char * valid_row = (PerPixelRays) ? valid_rays + y*w : NULL;
+                    size_t count = 0;
+                    for (size_t x = 0; x < w; x++) {
+                        size_t valid = (depth_row[x] >= d_min) & (depth_row[x] <= d_max);
+                        if (PerPixelRays) valid &= valid_row[x];
+                        count += valid;
+                    }
+                    row_offsets[y + 1] = count;
+                }
+                for (size_t y = 0; y < h; y++) row_offsets[y + 1] += row_offsets[y];
+            }
+
+            points.resize(row_offsets[h]);
+            if (colors != NULL) colors->resize(row_offsets[h]);
+
+#pragma omp parallel for
+            for (size_t y = 0; y < h; y++) {
+                const unsigned short * depth_row = depth_img.RowPtr(y);
+                const Eigen::Matrix<unsigned char,3,1> * rgb_row = (rgb_img != NULL) ? rgb_img->RowPtr(y) : NULL;
+                Eigen::Vector3f * pt = points.data() + row_offsets[y];
+                Eigen::Vector3f * col = (colors != NULL) ? colors->data() + row_offsets[y] : NULL;
+                const size_t count = row_offsets[y + 1] - row_offsets[y];
+                const float * x_ray_row = (PerPixelRays) ? x_rays + y*w : x_rays;
+                const float * y_ray_row = (PerPixelRays) ? y_rays + y*w : NULL;
+                const float y_ray = (PerPixelRays) ? 0.0f : y_rays[y];
+                const unsigned char * valid_row = (PerPixelRays) ? valid_rays + y*w : NULL;
+                const size_t keep = keep_invalid;
+                // Branchless compaction: every pixel is written to the next free slot, which only advances for
+                // kept pixels; stopping at the row's count keeps writes inside the row's output block
+                size_t k = 0;
+                for (size_t x = 0; x < w && k < count; x++) {
+                    size_t valid = (depth_row[x] >= d_min) & (depth_row[x] <= d_max);
+                    if (PerPixelRays) valid &= valid_row[x];
+                    // Rays of invalid pixels are finite, so these come out as zero points
+                    float d = (float)(depth_row[x]*valid)*depth_scale;
+                    pt[k] = Eigen::Vector3f(x_ray_row[x]*d, ((PerPixelRays) ? y_ray_row[x] : y_ray)*d, d);
+                    if (col != NULL) col[k] = rgb_row[x].cast<float>()*(1.0f/255.0f);
+                    k += valid | keep;
+                }
+            }
+        }
+
+        const uint64_t emptyZBufferEntry = std::numeric_limits<uint64_t>::max();
+
+        inline void atomicMin(std::atomic<uint64_t> &target, uint64_t val) {
+            uint64_t current = target.load(std::memory_order_relaxed);
+            while (val < current && !target.compare_exchange_weak(current, val, std::memory_order_relaxed));
+        }
+
+        // Rasterizes (optionally transformed) points into a z-buffer of 64-bit words packing the depth bits above
+        // the point index, so that an atomic min keeps the nearest point per pixel (ties go to the lower index);
+        // positive float bit patterns order like the values themselves. Points are splatted as disks of the given
+        // metric radius.
+        void rasterizePoints(const std::vector<Eigen::Vector3f> &points,
+                             const Eigen::Matrix3f &intr,
+                             const Eigen::Matrix3f &rot_mat,
+                             const Eigen::Vector3f &t_vec,
+                             const LensDistortion &distortion,
+                             float point_radius,
+                             size_t width, size_t height,
+                             std::vector<std::atomic<uint64_t> > &zbuffer)
+        {
+            const size_t num_pixels = width*height;
+#pragma omp parallel for
+            for (size_t i = 0; i < num_pixels; i++) {
+                zbuffer[i].store(emptyZBufferEntry, std::memory_order_relaxed);
+            }
+
+            const bool distorted = !distortion.isIdentity();
+            const float fx = intr(0,0), fy = intr(1,1), cx = intr(0,2), cy = intr(1,2);
+            const float radius_scale = point_radius*std::max(fx, fy);
+            const size_t num_points = std::min(points.size(), (size_t)std::numeric_limits<uint32_t>::max());
+
+#pragma omp parallel for
+            for (size_t i = 0; i < num_points; i++) {
+                Eigen::Vector3f pt = rot_mat*points[i] + t_vec;
+                if (!(pt[2] > 0.0f)) continue;
+
+                float z_inv = 1.0f/pt[2];
+                Eigen::Vector2f uv(pt[0]*z_inv, pt[1]*z_inv);
+                if (distorted) uv = distortion.distort(uv);
+                float u = fx*uv[0] + cx, v = fy*uv[1] + cy;
+                if (!(u > -0.5f - radius_scale*z_inv && v > -0.5f - radius_scale*z_inv &&
+                      u < width - 0.5f + radius_scale*z_inv && v < height - 0.5f + radius_scale*z_inv)) continue;
+
+                uint32_t depth_bits;
+                std::memcpy(&depth_bits, &pt[2], sizeof(float));
+                const uint64_t entry = ((uint64_t)depth_bits << 32) | (uint64_t)i;
+
+                long x = std::lround(u), y = std::lround(v);
+                if (radius_scale <= 0.0f) {
+                    if (x >= 0 && y >= 0 && x < (long)width && y < (long)height) atomicMin(zbuffer[y*width + x], entry);
+                    continue;
+                }
+
+                float r_pix = radius_scale*z_inv;
+                float r_pix_sq = r_pix*r_pix;
+                long r = (long)std::ceil(r_pix);
+                long y_min = std::max(y - r, 0L), y_max = std::min(y + r, (long)height - 1);
+                long x_min = std::max(x - r, 0L), x_max = std::min(x + r, (long)width - 1);
+                for (long yy = y_min; yy <= y_max; yy++) {
+                    for (long xx = x_min; xx <= x_max; xx++) {
+                        float dx = xx - u, dy = yy - v;
+                        if (dx*dx + dy*dy <= r_pix_sq || (xx == x && yy == y)) atomicMin(zbuffer[yy*width + xx], entry);
+                    }
+                }
+            }
+        }
+
+        inline float zBufferEntryDepth(uint64_t entry) {
+            uint32_t depth_bits = (uint32_t)(entry >> 32);
+            float depth;
+            std::memcpy(&depth, &depth_bits, sizeof(float));
+            return depth;
+        }
+
+        inline unsigned short toDepthImageValue(float depth) {
+            return (unsigned short)std::min(depth*1000.0f, 65535.0f);
+        }
+
+        void rasterizeDepthImage(const std::vector<Eigen::Vector3f> &points,
+                                 const Eigen::Matrix3f &intr,
+                                 const Eigen::Matrix3f &rot_mat,
+                                 const Eigen::Vector3f &t_vec,
+                                 const LensDistortion &distortion,
+                                 float point_radius,
+                                 pangolin::Image<unsigned short> &depth_img)
+        {
+            std::vector<std::atomic<uint64_t> > zbuffer(depth_img.w*depth_img.h);
+            rasterizePoints(points, intr, rot_mat, t_vec, distortion, point_radius, depth_img.w, depth_img.h, zbuffer);
+
+#pragma omp parallel for
+            for (size_t y = 0; y < depth_img.h; y++) {
+                unsigned short * depth_row = depth_img.RowPtr(y);
+                for (size_t x = 0; x < depth_img.w; x++) {
+                    uint64_t entry = zbuffer[y*depth_img.w + x].load(std::memory_order_relaxed);
+                    depth_row[x] = (entry == emptyZBufferEntry) ? 0 : toDepthImageValue(zBufferEntryDepth(entry));
+                }
+            }
+        }
+
+        void rasterizeRGBDImages(const std::vector<Eigen::Vector3f> &points,
+                                 const std::vector<Eigen::Vector3f> &colors,
+                                 const Eigen::Matrix3f &intr,
+                                 const Eigen::Matrix3f &rot_mat,
+                                 const Eigen::Vector3f &t_vec,
+                                 const LensDistortion &distortion,
+                                 float point_radius,
+                                 pangolin::Image<Eigen::Matrix<unsigned char,3,1> > &rgb_img,
+                                 pangolin::Image<unsigned short> &depth_img)
+        {
+            std::vector<std::atomic<uint64_t> > zbuffer(depth_img.w*depth_img.h);
+            rasterizePoints(points, intr, rot_mat, t_vec, distortion, point_radius, depth_img.w, depth_img.h, zbuffer);
+
+#pragma omp parallel for
+            for (size_t y = 0; y < depth_img.h; y++) {
+                unsigned short * depth_row = depth_img.RowPtr(y);
+                Eigen::Matrix<unsigned char,3,1> * rgb_row = rgb_img.RowPtr(y);
+                for (size_t x = 0; x < depth_img.w; x++) {
+                    uint64_t entry = zbuffer[y*depth_img.w + x].load(std::memory_order_relaxed);
+                    if (entry == emptyZBufferEntry) {
+                        depth_row[x] = 0;
+                        rgb_row[x].setZero();
+                    } else {
+                        depth_row[x] = toDepthImageValue(zBufferEntryDepth(entry));
+                        rgb_row[x] = (255.0f*colors[entry & 0xFFFFFFFF]).cast<unsigned char>();
+                    }
+                }
+            }
+        }
+
+        void rasterizeIndexMap(const std::vector<Eigen::Vector3f> &points,
+                               const Eigen::Matrix3f &intr,
+                               const Eigen::Matrix3f &rot_mat,
+                               const Eigen::Vector3f &t_vec,
+                               const LensDistortion &distortion,
+                               float point_radius,
+                               pangolin::Image<size_t> &index_map)
+        {
+            std::vector<std::atomic<uint64_t> > zbuffer(index_map.w*index_map.h);
+            rasterizePoints(points, intr, rot_mat, t_vec, distortion, point_radius, index_map.w, index_map.h, zbuffer);
+
+            const size_t empty = std::numeric_limits<std::size_t>::max();
+#pragma omp parallel for
+            for (size_t y = 0; y < index_map.h; y++) {
+                size_t * index_row = index_map.RowPtr(y);
+                for (size_t x = 0; x < index_map.w; x++) {
+                    uint64_t entry = zbuffer[y*index_map.w + x].load(std::memory_order_relaxed);
+                    index_row[x] = (entry == emptyZBufferEntry) ? empty : (size_t)(entry & 0xFFFFFFFF);
+                }
+            }
+        }
+    }
+
+    DepthImageBackProjector::DepthImageBackProjector(size_t width, size_t height, const Eigen::Matrix3f &intr, float depth_scale)
+            : width_(width),
+              height_(height),
+              intr_(intr),
+              depth_scale_(depth_scale),
+              min_depth_(0.0f),
+              max_depth_(std::numeric_limits<float>::infinity()),
+              per_pixel_rays_(false)
+    {
+        computePinholeRays(width_, height_, intr_, x_rays_, y_rays_);
+    }
+
+    DepthImageBackProjector::DepthImageBackProjector(size_t width, size_t height, const Eigen::Matrix3f &intr, const LensDistortion &distortion, float depth_scale)
+            : width_(width),
+              height_(height),
+              intr_(intr),
+              distortion_(distortion),
+              depth_scale_(depth_scale),
+              min_depth_(0.0f),
+              max_depth_(std::numeric_limits<float>::infinity()),
+              per_pixel_rays_(!distortion.isIdentity())
+    {
+        if (per_pixel_rays_) {
+            computeUndistortedRays(width_, height_, intr_, distortion_, x_rays_, y_rays_, valid_rays_);
+        } else {
+            computePinholeRays(width_, height_, intr_, x_rays_, y_rays_);
+        }
+    }
+
+    void DepthImageBackProjector::depthImageToPoints(const pangolin::Image<unsigned short> &depth_img,
+                                                     std::vector<Eigen::Vector3f> &points,
+                                                     bool keep_invalid) const
+    {
+        if (!depth_img.ptr || depth_img.w != width_ || depth_img.h != height_) return;
+
+        std::vector<unsigned short> filtered_data;
+        pangolin::Image<unsigned short> filtered_img;
+        const pangolin::Image<unsigned short> &depth = get_filtered_depth_(depth_img, filtered_data, filtered_img);
+
+        if (per_pixel_rays_) {
+            backProjectDepthImage<true>(depth, NULL, x_rays_.data(), y_rays_.data(), valid_rays_.data(), depth_scale_, min_depth_, max_depth_, keep_invalid, points, NULL);
+        } else {
+            backProjectDepthImage<false>(depth, NULL, x_rays_.data(), y_rays_.data(), valid_rays_.data(), depth_scale_, min_depth_, max_depth_, keep_invalid, points, NULL);
+        }
+    }
+
+    void DepthImageBackProjector::RGBDImagesToPointsColors(const pangolin::Image<Eigen::Matrix<unsigned char,3,1> > &rgb_img,
+                                                           const pangolin::Image<unsigned short> &depth_img,
+                                                           std::vector<Eigen::Vector3f> &points,
+                                                           std::vector<Eigen::Vector3f> &colors,
+                                                           bool keep_invalid) const
+    {
+        if (!depth_img.ptr || !rgb_img.ptr || depth_img.w != width_ || depth_img.h != height_ || rgb_img.w != width_ || rgb_img.h != height_) return;
+
+        std::vector<unsigned short> filtered_data;
+        pangolin::Image<unsigned short> filtered_img;
+        const pangolin::Image<unsigned short> &depth = get_filtered_depth_(depth_img, filtered_data, filtered_img);
+
+        if (per_pixel_rays_) {
+            backProjectDepthImage<true>(depth, &rgb_img, x_rays_.data(), y_rays_.data(), valid_rays_.data(), depth_scale_, min_depth_, max_depth_, keep_invalid, points, &colors);
+        } else {
+            backProjectDepthImage<false>(depth, &rgb_img, x_rays_.data(), y_rays_.data(), valid_rays_.data(), depth_scale_, min_depth_, max_depth_, keep_invalid, points, &colors);
+        }
+    }
+
+    const pangolin::Image<unsigned short>& DepthImageBackProjector::get_filtered_depth_(const pangolin::Image<unsigned short> &depth_img,
+                                                                                      std::vector<unsigned short> &filtered_data,
+                                                                                      pangolin::Image<unsigned short> &filtered_img) const
+    {
+        if (!filter_params_.isEnabled()) return depth_img;
+
+        filtered_data.resize(depth_img.w*depth_img.h);
+        for (size_t y = 0; y < depth_img.h; y++) {
+            std::copy(depth_img.RowPtr(y), depth_img.RowPtr(y) + depth_img.w, filtered_data.data() + y*depth_img.w);
+        }
+        filtered_img = pangolin::Image<unsigned short>(filtered_data.data(), depth_img.w, depth_img.h, depth_img.w*sizeof(unsigned short));
+        filterDepthImage(filtered_img, filter_params_);
+        return filtered_img;
+    }
+
     void depthImageToPoints(const pangolin::Image<unsigned short> &depth_img,
                             const Eigen::Matrix3f &intr,
                             std::vector<Eigen::Vector3f> &points,
@@ -8,18 +409,9 @@ namespace cilantro {
     {
         if (!depth_img.ptr) return;
 
-        points.resize(depth_img.w*depth_img.h);
-        size_t k = 0;
-        for (size_t y = 0; y < depth_img.h; y++) {
-            for (size_t x = 0; x < depth_img.w; x++) {
-                float d = depth_img(x,y)/1000.0f;
-                if (keep_invalid || d > 0.0f) {
-                    points[k] = Eigen::Vector3f((x - intr(0,2)) * d / intr(0,0), (y - intr(1,2)) * d / intr(1,1), d);
-                    k++;
-                }
-            }
-        }
-        points.resize(k);
+        std::vector<float> x_rays, y_rays;
+        computePinholeRays(depth_img.w, depth_img.h, intr, x_rays, y_rays);
+        backProjectDepthImage<false>(depth_img, NULL, x_rays.data(), y_rays.data(), NULL, 0.001f, 0.0f, std::numeric_limits<float>::infinity(), keep_invalid, points, NULL);
     }
 
     void RGBDImagesToPointsColors(const pangolin::Image<Eigen::Matrix<unsigned char,3,1> > &rgb_img,
@@ -31,70 +423,43 @@ namespace cilantro {
     {
         if (!depth_img.ptr || !rgb_img.ptr || depth_img.w != rgb_img.w || depth_img.h != rgb_img.h) return;
 
-        points.resize(depth_img.w*depth_img.h);
-        colors.resize(depth_img.w*depth_img.w);
-        size_t k = 0;
-        for (size_t y = 0; y < depth_img.h; y++) {
-            for (size_t x = 0; x < depth_img.w; x++) {
-                float d = depth_img(x,y)/1000.0f;
-                if (keep_invalid || d > 0.0f) {
-                    points[k] = Eigen::Vector3f((x - intr(0,2)) * d / intr(0,0), (y - intr(1,2)) * d / intr(1,1), d);
-                    colors[k] = rgb_img(x,y).cast<float>()/255.0f;
-                    k++;
-                }
-            }
-        }
-        points.resize(k);
-        colors.resize(k);
+        std::vector<float> x_rays, y_rays;
+        computePinholeRays(depth_img.w, depth_img.h, intr, x_rays, y_rays);
+        backProjectDepthImage<false>(depth_img, &rgb_img, x_rays.data(), y_rays.data(), NULL, 0.001f, 0.0f, std::numeric_limits<float>::infinity(), keep_invalid, points, &colors);
     }
 
     void pointsToDepthImage(const std::vector<Eigen::Vector3f> &points,
                             const Eigen::Matrix3f &intr,
-                            pangolin::Image<unsigned short> &depth_img)
+                            pangolin::Image<unsigned short> &depth_img,
+                            const LensDistortion &distortion,
+                            float point_radius)
     {
         if (!depth_img.ptr) return;
-
-        depth_img.Memset(0);
-        for (size_t i = 0; i < points.size(); i++) {
-            const Eigen::Vector3f& pt = points[i];
-            size_t x = (size_t)std::llround(pt[0]*intr(0,0)/pt[2] + intr(0,2));
-            size_t y = (size_t)std::llround(pt[1]*intr(1,1)/pt[2] + intr(1,2));
-            if (x < depth_img.w && y < depth_img.h && pt[2] >= 0.0f && (depth_img(x,y) == 0 || 1000.0f*pt[2] < depth_img(x,y))) {
-                depth_img(x,y) = (unsigned short)(pt[2]*1000.0f);
-            }
-        }
+        rasterizeDepthImage(points, intr, Eigen::Matrix3f::Identity(), Eigen::Vector3f::Zero(), distortion, point_radius, depth_img);
     }
 
     void pointsToDepthImage(const std::vector<Eigen::Vector3f> &points,
                             const Eigen::Matrix3f &intr,
                             const Eigen::Matrix3f &rot_mat,
                             const Eigen::Vector3f &t_vec,
-                            pangolin::Image<unsigned short> &depth_img)
+                            pangolin::Image<unsigned short> &depth_img,
+                            const LensDistortion &distortion,
+                            float point_radius)
     {
-        std::vector<Eigen::Vector3f> points_t(points.size());
-        Eigen::Map<Eigen::Matrix<float,3,Eigen::Dynamic> >((float *)points_t.data(), 3, points_t.size()) = (rot_mat*Eigen::Map<Eigen::Matrix<float,3,Eigen::Dynamic> >((float *)points.data(), 3, points.size())).colwise() + t_vec;
-        pointsToDepthImage(points_t, intr, depth_img);
+        if (!depth_img.ptr) return;
+        rasterizeDepthImage(points, intr, rot_mat, t_vec, distortion, point_radius, depth_img);
     }
 
     void pointsColorsToRGBDImages(const std::vector<Eigen::Vector3f> &points,
                                   const std::vector<Eigen::Vector3f> &colors,
                                   const Eigen::Matrix3f &intr,
                                   pangolin::Image<Eigen::Matrix<unsigned char,3,1> > &rgb_img,
-                                  pangolin::Image<unsigned short> &depth_img)
+                                  pangolin::Image<unsigned short> &depth_img,
+                                  const LensDistortion &distortion,
+                                  float point_radius)
     {
         if (!rgb_img.ptr || !depth_img.ptr || points.size() != colors.size() || rgb_img.w != depth_img.w || rgb_img.h != depth_img.h) return;
-
-        rgb_img.Memset(0);
-        depth_img.Memset(0);
-        for (size_t i = 0; i < points.size(); i++) {
-            const Eigen::Vector3f& pt = points[i];
-            size_t x = (size_t)std::llround(pt[0]*intr(0,0)/pt[2] + intr(0,2));
-            size_t y = (size_t)std::llround(pt[1]*intr(1,1)/pt[2] + intr(1,2));
-            if (x < depth_img.w && y < depth_img.h && pt[2] >= 0.0f && (depth_img(x,y) == 0 || 1000.0f*pt[2] < depth_img(x,y))) {
-                depth_img(x,y) = (unsigned short)(pt[2]*1000.0f);
-                rgb_img(x,y) = (255.0f*colors[i]).cast<unsigned char>();
-            }
-        }
+        rasterizeRGBDImages(points, colors, intr, Eigen::Matrix3f::Identity(), Eigen::Vector3f::Zero(), distortion, point_radius, rgb_img, depth_img);
     }
 
     void pointsColorsToRGBDImages(const std::vector<Eigen::Vector3f> &points,
@@ -103,40 +468,33 @@ namespace cilantro {
                                   const Eigen::Matrix3f &rot_mat,
                                   const Eigen::Vector3f &t_vec,
                                   pangolin::Image<Eigen::Matrix<unsigned char,3,1> > &rgb_img,
-                                  pangolin::Image<unsigned short> &depth_img)
+                                  pangolin::Image<unsigned short> &depth_img,
+                                  const LensDistortion &distortion,
+                                  float point_radius)
     {
-        std::vector<Eigen::Vector3f> points_t(points.size());
-        Eigen::Map<Eigen::Matrix<float,3,Eigen::Dynamic> >((float *)points_t.data(), 3, points_t.size()) = (rot_mat*Eigen::Map<Eigen::Matrix<float,3,Eigen::Dynamic> >((float *)points.data(), 3, points.size())).colwise() + t_vec;
-        pointsColorsToRGBDImages(points_t, colors, intr, rgb_img, depth_img);
+        if (!rgb_img.ptr || !depth_img.ptr || points.size() != colors.size() || rgb_img.w != depth_img.w || rgb_img.h != depth_img.h) return;
+        rasterizeRGBDImages(points, colors, intr, rot_mat, t_vec, distortion, point_radius, rgb_img, depth_img);
     }
 
     void pointsToIndexMap(const std::vector<Eigen::Vector3f> &points,
                           const Eigen::Matrix3f &intr,
-                          pangolin::Image<size_t> &index_map)
+                          pangolin::Image<size_t> &index_map,
+                          const LensDistortion &distortion,
+                          float point_radius)
     {
         if (!index_map.ptr) return;
-
-        size_t empty = std::numeric_limits<std::size_t>::max();
-        index_map.Fill(empty);
-
-        for (size_t i = 0; i < points.size(); i++) {
-            const Eigen::Vector3f& pt = points[i];
-            size_t x = (size_t)std::llround(pt[0]*intr(0,0)/pt[2] + intr(0,2));
-            size_t y = (size_t)std::llround(pt[1]*intr(1,1)/pt[2] + intr(1,2));
-            if (x < index_map.w && y < index_map.h && pt[2] >= 0.0f && (index_map(x,y) == empty || pt[2] < points[index_map(x,y)][2])) {
-                index_map(x,y) = i;
-            }
-        }
+        rasterizeIndexMap(points, intr, Eigen::Matrix3f::Identity(), Eigen::Vector3f::Zero(), distortion, point_radius, index_map);
     }
 
     void pointsToIndexMap(const std::vector<Eigen::Vector3f> &points,
                           const Eigen::Matrix3f &intr,
                           const Eigen::Matrix3f &rot_mat,
                           const Eigen::Vector3f &t_vec,
-                          pangolin::Image<size_t> &index_map)
+                          pangolin::Image<size_t> &index_map,
+                          const LensDistortion &distortion,
+                          float point_radius)
     {
-        std::vector<Eigen::Vector3f> points_t(points.size());
-        Eigen::Map<Eigen::Matrix<float,3,Eigen::Dynamic> >((float *)points_t.data(), 3, points_t.size()) = (rot_mat*Eigen::Map<Eigen::Matrix<float,3,Eigen::Dynamic> >((float *)points.data(), 3, points.size())).colwise() + t_vec;
-        pointsToIndexMap(points_t, intr, index_map);
+        if (!index_map.ptr) return;
+        rasterizeIndexMap(points, intr, rot_mat, t_vec, distortion, point_radius, index_map);
     }
 }
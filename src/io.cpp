@@ -1,68 +1,1104 @@
 #include <cilantro/io.hpp>
 #include <cilantro/3rd_party/tinyply/tinyply.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+#include <future>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 namespace cilantro {
-    void readPointCloudFromPLYFile(const std::string &filename, PointCloud &cloud) {
-        // Data holders
-        std::vector<float> vertex_data;
-        std::vector<float> normal_data;
-        std::vector<uint8_t> color_data;
+    MemoryMappedFile::MemoryMappedFile()
+            : is_open_(false),
+              data_(NULL),
+              size_(0)
+    {}
+
+    MemoryMappedFile::MemoryMappedFile(const std::string &file_name)
+            : is_open_(false),
+              data_(NULL),
+              size_(0)
+    {
+        open(file_name);
+    }
 
-        std::ifstream ss(filename, std::ios::binary);
-        tinyply::PlyFile file(ss);
+    MemoryMappedFile::MemoryMappedFile(MemoryMappedFile &&other)
+            : is_open_(other.is_open_),
+              data_(other.data_),
+              size_(other.size_)
+    {
+        other.is_open_ = false;
+        other.data_ = NULL;
+        other.size_ = 0;
+    }
 
-        // Initialize PLY data holders
-        size_t vertex_count = file.request_properties_from_element("vertex", {"x", "y", "z"}, vertex_data);
-        size_t normal_count = file.request_properties_from_element("vertex", {"nx", "ny", "nz"}, normal_data);
-        size_t color_count = file.request_properties_from_element("vertex", {"red", "green", "blue"}, color_data);
+    MemoryMappedFile& MemoryMappedFile::operator=(MemoryMappedFile &&other) {
+        if (this != &other) {
+            close();
+            std::swap(is_open_, other.is_open_);
+            std::swap(data_, other.data_);
+            std::swap(size_, other.size_);
+        }
+        return *this;
+    }
 
-        // Read PLY data
-        file.read(ss);
+    MemoryMappedFile::~MemoryMappedFile() {
+        close();
+    }
 
-        // Populate cloud
-        cloud.points.resize(vertex_count);
-        std::memcpy(cloud.points.data(), vertex_data.data(), 3*vertex_count*sizeof(float));
+    bool MemoryMappedFile::open(const std::string &file_name) {
+        close();
 
-        cloud.normals.resize(normal_count);
-        std::memcpy(cloud.normals.data(), normal_data.data(), 3*normal_count*sizeof(float));
+        int fd = ::open(file_name.c_str(), O_RDONLY);
+        if (fd < 0) return false;
 
-        cloud.colors.resize(color_count);
-        for (int i = 0; i < color_count; i++) {
-            cloud.colors[i] = Eigen::Vector3f(color_data[3*i], color_data[3*i+1], color_data[3*i+2])/255.0f;
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            return false;
         }
+
+        size_t size = st.st_size;
+        const char * data = NULL;
+        if (size > 0) {
+            void * ptr = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+            if (ptr == MAP_FAILED) {
+                ::close(fd);
+                return false;
+            }
+            data = (const char *)ptr;
+        }
+        // The mapping stays valid after closing the descriptor
+        ::close(fd);
+
+        is_open_ = true;
+        data_ = data;
+        size_ = size;
+        return true;
+    }
+
+    void MemoryMappedFile::prefetch(size_t begin, size_t end) const {
+        end = std::min(end, size_);
+        if (data_ == NULL || begin >= end) return;
+        size_t page_size = sysconf(_SC_PAGESIZE);
+        begin -= begin%page_size;
+        madvise((void *)(data_ + begin), end - begin, MADV_WILLNEED);
+    }
+
+    void MemoryMappedFile::evict(size_t begin, size_t end) const {
+        end = std::min(end, size_);
+        if (data_ == NULL || begin >= end) return;
+        size_t page_size = sysconf(_SC_PAGESIZE);
+        begin -= begin%page_size;
+        madvise((void *)(data_ + begin), end - begin, MADV_DONTNEED);
+    }
+
+    void MemoryMappedFile::close() {
+        if (data_ != NULL) munmap((void *)data_, size_);
+        is_open_ = false;
+        data_ = NULL;
+        size_ = 0;
+    }
+
+    namespace {
+        enum struct PLYType {INVALID, INT8, UINT8, INT16, UINT16, INT32, UINT32, FLOAT32, FLOAT64};
+
+        struct PLYProperty {
+            std::string name;
+            PLYType type;
+            size_t offset;
+            bool isList;
+        };
+
+        struct PLYElement {
+            std::string name;
+            size_t count;
+            size_t stride;
+            bool hasLists;
+            std::vector<PLYProperty> properties;
+
+            inline const PLYProperty * findProperty(const std::string &property_name) const {
+                for (size_t i = 0; i < properties.size(); i++) {
+                    if (properties[i].name == property_name) return &properties[i];
+                }
+                return NULL;
+            }
+        };
+
+        struct PLYHeader {
+            bool binaryLittleEndian;
+            size_t dataOffset;
+            std::vector<PLYElement> elements;
+        };
+
+        inline bool hostIsLittleEndian() {
+            const uint16_t one = 1;
+            return *((const uint8_t *)&one) == 1;
+        }
+
+        PLYType getPLYType(const std::string &name) {
+            if (name == "char" || name == "int8") return PLYType::INT8;
+            if (name == "uchar" || name == "uint8") return PLYType::UINT8;
+            if (name == "short" || name == "int16") return PLYType::INT16;
+            if (name == "ushort" || name == "uint16") return PLYType::UINT16;
+            if (name == "int" || name == "int32") return PLYType::INT32;
+            if (name == "uint" || name == "uint32") return PLYType::UINT32;
+            if (name == "float" || name == "float32") return PLYType::FLOAT32;
+            if (name == "double" || name == "float64") return PLYType::FLOAT64;
+            return PLYType::INVALID;
+        }
+
+        size_t getPLYTypeSize(PLYType type) {
+            switch (type) {
+                case PLYType::INT8: case PLYType::UINT8: return 1;
+                case PLYType::INT16: case PLYType::UINT16: return 2;
+                case PLYType::INT32: case PLYType::UINT32: case PLYType::FLOAT32: return 4;
+                case PLYType::FLOAT64: return 8;
+                default: return 0;
+            }
+        }
+
+        bool parsePLYHeader(const char * data, size_t size, PLYHeader &header) {
+            header.binaryLittleEndian = false;
+            header.dataOffset = 0;
+            header.elements.clear();
+
+            size_t pos = 0;
+            bool magic_found = false;
+            while (pos < size) {
+                size_t line_end = pos;
+                while (line_end < size && data[line_end] != '\n') line_end++;
+                if (line_end == size) return false;
+
+                std::string line(data + pos, line_end - pos);
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                pos = line_end + 1;
+
+                std::istringstream iss(line);
+                std::string keyword;
+                iss >> keyword;
+
+                if (!magic_found) {
+                    if (keyword != "ply") return false;
+                    magic_found = true;
+                } else if (keyword == "format") {
+                    std::string format;
+                    iss >> format;
+                    header.binaryLittleEndian = format == "binary_little_endian";
+                } else if (keyword == "element") {
+                    PLYElement element;
+                    iss >> element.name >> element.count;
+                    element.stride = 0;
+                    element.hasLists = false;
+                    header.elements.emplace_back(std::move(element));
+                } else if (keyword == "property") {
+                    if (header.elements.empty()) return false;
+                    PLYElement &element = header.elements.back();
+                    PLYProperty property;
+                    std::string type_name;
+                    iss >> type_name;
+                    property.isList = type_name == "list";
+                    if (property.isList) {
+                        std::string count_type, item_type;
+                        iss >> count_type >> item_type;
+                        property.type = getPLYType(item_type);
+                        element.hasLists = true;
+                    } else {
+                        property.type = getPLYType(type_name);
+                    }
+                    iss >> property.name;
+                    if (property.type == PLYType::INVALID) return false;
+                    property.offset = element.stride;
+                    if (!property.isList) element.stride += getPLYTypeSize(property.type);
+                    element.properties.emplace_back(std::move(property));
+                } else if (keyword == "end_header") {
+                    header.dataOffset = pos;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        template <typename T>
+        inline T readUnaligned(const char * ptr) {
+            T val;
+            std::memcpy(&val, ptr, sizeof(T));
+            return val;
+        }
+
+        inline float readPLYScalarAsFloat(const char * ptr, PLYType type) {
+            switch (type) {
+                case PLYType::INT8: return (float)readUnaligned<int8_t>(ptr);
+                case PLYType::UINT8: return (float)readUnaligned<uint8_t>(ptr);
+                case PLYType::INT16: return (float)readUnaligned<int16_t>(ptr);
+                case PLYType::UINT16: return (float)readUnaligned<uint16_t>(ptr);
+                case PLYType::INT32: return (float)readUnaligned<int32_t>(ptr);
+                case PLYType::UINT32: return (float)readUnaligned<uint32_t>(ptr);
+                case PLYType::FLOAT32: return readUnaligned<float>(ptr);
+                case PLYType::FLOAT64: return (float)readUnaligned<double>(ptr);
+                default: return std::numeric_limits<float>::quiet_NaN();
+            }
+        }
+
+        // Integer colors are normalized by their type range; floating point colors are taken as they are
+        inline float getPLYColorScale(PLYType type) {
+            switch (type) {
+                case PLYType::UINT8: return 1.0f/255.0f;
+                case PLYType::UINT16: return 1.0f/65535.0f;
+                case PLYType::FLOAT32: case PLYType::FLOAT64: return 1.0f;
+                default: return 1.0f/255.0f;
+            }
+        }
+
+        // Locations of the vertex properties of interest within a binary little endian file
+        struct PLYVertexLayout {
+            const PLYElement * vertex;
+            size_t dataOffset;
+            const PLYProperty * point[3];
+            const PLYProperty * normal[3];
+            const PLYProperty * color[3];
+            bool hasNormals;
+            bool hasColors;
+        };
+
+        bool getPLYVertexLayout(const PLYHeader &header, size_t file_size, PLYVertexLayout &layout) {
+            if (!header.binaryLittleEndian || !hostIsLittleEndian()) return false;
+
+            // Elements preceding the vertices must have a fixed size
+            size_t offset = header.dataOffset;
+            layout.vertex = NULL;
+            for (size_t i = 0; i < header.elements.size(); i++) {
+                if (header.elements[i].name == "vertex") {
+                    layout.vertex = &header.elements[i];
+                    break;
+                }
+                if (header.elements[i].hasLists) return false;
+                offset += header.elements[i].count*header.elements[i].stride;
+            }
+            if (layout.vertex == NULL || layout.vertex->hasLists) return false;
+            if (offset + layout.vertex->count*layout.vertex->stride > file_size) return false;
+            layout.dataOffset = offset;
+
+            const char * point_names[3] = {"x", "y", "z"};
+            const char * normal_names[3] = {"nx", "ny", "nz"};
+            const char * color_names[3] = {"red", "green", "blue"};
+            layout.hasNormals = true;
+            layout.hasColors = true;
+            for (size_t k = 0; k < 3; k++) {
+                layout.point[k] = layout.vertex->findProperty(point_names[k]);
+                layout.normal[k] = layout.vertex->findProperty(normal_names[k]);
+                layout.color[k] = layout.vertex->findProperty(color_names[k]);
+                if (layout.point[k] == NULL) return false;
+                if (layout.normal[k] == NULL) layout.hasNormals = false;
+                if (layout.color[k] == NULL) layout.hasColors = false;
+            }
+            return true;
+        }
+
+        // True if the three properties are consecutive float32 values
+        inline bool isPackedFloat3(const PLYProperty * const props[3]) {
+            for (size_t k = 0; k < 3; k++) {
+                if (props[k]->type != PLYType::FLOAT32 || props[k]->offset != props[0]->offset + 4*k) return false;
+            }
+            return true;
+        }
+
+        // Copies vertex range [begin,end) of the mapped vertex block into the destination arrays (which hold end-begin
+        // entries each); destinations may be NULL
+        void readPLYVertexRange(const char * vertex_data,
+                                const PLYVertexLayout &layout,
+                                size_t begin, size_t end,
+                                Eigen::Vector3f * points,
+                                Eigen::Vector3f * normals,
+                                Eigen::Vector3f * colors)
+        {
+            size_t stride = layout.vertex->stride;
+            size_t num = end - begin;
+            const char * base = vertex_data + begin*stride;
+
+            // Tightly packed xyz-only data is copied in one go
+            if (points != NULL && stride == 3*sizeof(float) && isPackedFloat3(layout.point)) {
+                std::memcpy(points, base, num*stride);
+                points = NULL;
+            }
+
+            bool packed_points = points != NULL && isPackedFloat3(layout.point);
+            bool packed_normals = normals != NULL && isPackedFloat3(layout.normal);
+            float color_scale[3];
+            if (colors != NULL) {
+                for (size_t k = 0; k < 3; k++) color_scale[k] = getPLYColorScale(layout.color[k]->type);
+            }
+
+#pragma omp parallel for
+            for (size_t i = 0; i < num; i++) {
+                const char * rec = base + i*stride;
+                if (points != NULL) {
+                    if (packed_points) {
+                        std::memcpy(points[i].data(), rec + layout.point[0]->offset, 3*sizeof(float));
+                    } else {
+                        for (size_t k = 0; k < 3; k++) points[i][k] = readPLYScalarAsFloat(rec + layout.point[k]->offset, layout.point[k]->type);
+                    }
+                }
+                if (normals != NULL) {
+                    if (packed_normals) {
+                        std::memcpy(normals[i].data(), rec + layout.normal[0]->offset, 3*sizeof(float));
+                    } else {
+                        for (size_t k = 0; k < 3; k++) normals[i][k] = readPLYScalarAsFloat(rec + layout.normal[k]->offset, layout.normal[k]->type);
+                    }
+                }
+                if (colors != NULL) {
+                    for (size_t k = 0; k < 3; k++) colors[i][k] = color_scale[k]*readPLYScalarAsFloat(rec + layout.color[k]->offset, layout.color[k]->type);
+                }
+            }
+        }
+
+        PointCloud readPLYVertexChunk(const char * vertex_data,
+                                      const PLYVertexLayout * layout,
+                                      const MemoryMappedFile * file,
+                                      size_t begin, size_t end,
+                                      PointCloud chunk)
+        {
+            size_t num = end - begin;
+            chunk.points.resize(num);
+            chunk.normals.resize((layout->hasNormals) ? num : 0);
+            chunk.colors.resize((layout->hasColors) ? num : 0);
+
+            readPLYVertexRange(vertex_data, *layout, begin, end,
+                               chunk.points.data(),
+                               (layout->hasNormals) ? chunk.normals.data() : NULL,
+                               (layout->hasColors) ? chunk.colors.data() : NULL);
+
+            // Decoded bytes are not needed anymore
+            size_t offset = vertex_data - file->data();
+            file->evict(offset + begin*layout->vertex->stride, offset + end*layout->vertex->stride);
+
+            return chunk;
+        }
+
+        void readPointCloudFromPLYFileTinyPLY(const std::string &filename, PointCloud &cloud) {
+            // Data holders
+            std::vector<float> vertex_data;
+            std::vector<float> normal_data;
+            std::vector<uint8_t> color_data;
+
+            std::ifstream ss(filename, std::ios::binary);
+            tinyply::PlyFile file(ss);
+
+            // Initialize PLY data holders
+            size_t vertex_count = file.request_properties_from_element("vertex", {"x", "y", "z"}, vertex_data);
+            size_t normal_count = file.request_properties_from_element("vertex", {"nx", "ny", "nz"}, normal_data);
+            size_t color_count = file.request_properties_from_element("vertex", {"red", "green", "blue"}, color_data);
+
+            // Read PLY data
+            file.read(ss);
+
+            // Populate cloud
+            cloud.points.resize(vertex_count);
+            std::memcpy(cloud.points.data(), vertex_data.data(), 3*vertex_count*sizeof(float));
+
+            cloud.normals.resize(normal_count);
+            std::memcpy(cloud.normals.data(), normal_data.data(), 3*normal_count*sizeof(float));
+
+            cloud.colors.resize(color_count);
+            for (int i = 0; i < color_count; i++) {
+                cloud.colors[i] = Eigen::Vector3f(color_data[3*i], color_data[3*i+1], color_data[3*i+2])/255.0f;
+            }
+        }
+
+        void writePointCloudToPLYFileTinyPLY(const std::string &filename, const PointCloud &cloud, bool binary) {
+            tinyply::PlyFile file;
+
+            std::vector<float> vertex_data(3*cloud.size());
+            std::memcpy(vertex_data.data(), cloud.points.data(), 3*cloud.size()*sizeof(float));
+            file.add_properties_to_element("vertex", {"x", "y", "z"}, vertex_data);
+
+            std::vector<float> normal_data;
+            if (cloud.hasNormals()) {
+                normal_data.resize(3*cloud.normals.size());
+                std::memcpy(normal_data.data(), cloud.normals.data(), 3*cloud.normals.size()*sizeof(float));
+                file.add_properties_to_element("vertex", {"nx", "ny", "nz"}, normal_data);
+            }
+
+            std::vector<uint8_t> color_data;
+            if (cloud.hasColors()) {
+                color_data.resize(3*cloud.colors.size());
+                for (int i = 0; i < cloud.colors.size(); i++) {
+                    color_data[3 * i + 0] = (uint8_t)(cloud.colors[i](0)*255.0f);
+                    color_data[3 * i + 1] = (uint8_t)(cloud.colors[i](1)*255.0f);
+                    color_data[3 * i + 2] = (uint8_t)(cloud.colors[i](2)*255.0f);
+                }
+                file.add_properties_to_element("vertex", {"red", "green", "blue"}, color_data);
+            }
+
+            // Write to file
+            std::filebuf fb;
+            fb.open(filename, std::ios::out | std::ios::binary);
+            std::ostream output_stream(&fb);
+            file.write(output_stream, binary);
+            fb.close();
+        }
+
+        inline uint8_t colorToByte(float val) {
+            return (uint8_t)(std::min(std::max(val, 0.0f), 1.0f)*255.0f + 0.5f);
+        }
+
+        // Binary little endian writer; vertex records are filled in parallel directly into a mapping of the output file
+        bool writePointCloudToPLYFileBinary(const std::string &filename, const PointCloud &cloud) {
+            if (!hostIsLittleEndian()) return false;
+
+            bool has_normals = cloud.hasNormals();
+            bool has_colors = cloud.hasColors();
+            size_t num_points = cloud.size();
+
+            std::ostringstream header_stream;
+            header_stream << "ply\nformat binary_little_endian 1.0\nelement vertex " << num_points << "\n";
+            header_stream << "property float x\nproperty float y\nproperty float z\n";
+            if (has_normals) header_stream << "property float nx\nproperty float ny\nproperty float nz\n";
+            if (has_colors) header_stream << "property uchar red\nproperty uchar green\nproperty uchar blue\n";
+            header_stream << "end_header\n";
+            std::string header(header_stream.str());
+
+            size_t stride = 3*sizeof(float) + ((has_normals) ? 3*sizeof(float) : 0) + ((has_colors) ? 3 : 0);
+            size_t total_size = header.size() + num_points*stride;
+
+            int fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0) return false;
+            if (ftruncate(fd, total_size) != 0) {
+                ::close(fd);
+                return false;
+            }
+            void * ptr = mmap(NULL, total_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (ptr == MAP_FAILED) return false;
+
+            char * out = (char *)ptr;
+            std::memcpy(out, header.data(), header.size());
+            out += header.size();
+
+            if (stride == 3*sizeof(float)) {
+                std::memcpy(out, cloud.points.data(), num_points*stride);
+            } else {
+#pragma omp parallel for
+                for (size_t i = 0; i < num_points; i++) {
+                    char * rec = out + i*stride;
+                    std::memcpy(rec, cloud.points[i].data(), 3*sizeof(float));
+                    rec += 3*sizeof(float);
+                    if (has_normals) {
+                        std::memcpy(rec, cloud.normals[i].data(), 3*sizeof(float));
+                        rec += 3*sizeof(float);
+                    }
+                    if (has_colors) {
+                        rec[0] = (char)colorToByte(cloud.colors[i](0));
+                        rec[1] = (char)colorToByte(cloud.colors[i](1));
+                        rec[2] = (char)colorToByte(cloud.colors[i](2));
+                    }
+                }
+            }
+
+            munmap(ptr, total_size);
+            return true;
+        }
+    }
+
+    void readPointCloudFromPLYFile(const std::string &filename, PointCloud &cloud) {
+        MemoryMappedFile file(filename);
+        PLYHeader header;
+        PLYVertexLayout layout;
+        if (!file.isOpen() || !parsePLYHeader(file.data(), file.size(), header) || !getPLYVertexLayout(header, file.size(), layout)) {
+            readPointCloudFromPLYFileTinyPLY(filename, cloud);
+            return;
+        }
+
+        size_t num_points = layout.vertex->count;
+        file.prefetch(layout.dataOffset, layout.dataOffset + num_points*layout.vertex->stride);
+
+        cloud.points.resize(num_points);
+        cloud.normals.resize((layout.hasNormals) ? num_points : 0);
+        cloud.colors.resize((layout.hasColors) ? num_points : 0);
+
+        readPLYVertexRange(file.data() + layout.dataOffset, layout, 0, num_points,
+                           cloud.points.data(),
+                           (layout.hasNormals) ? cloud.normals.data() : NULL,
+                           (layout.hasColors) ? cloud.colors.data() : NULL);
     }
 
     void writePointCloudToPLYFile(const std::string &filename, const PointCloud &cloud, bool binary) {
-        tinyply::PlyFile file;
+        if (binary && writePointCloudToPLYFileBinary(filename, cloud)) return;
+        writePointCloudToPLYFileTinyPLY(filename, cloud, binary);
+    }
+
+    struct PLYPointCloudStreamReader::State_ {
+        MemoryMappedFile file;
+        PLYHeader header;
+        PLYVertexLayout layout;
+        size_t numRead;
+        size_t numRequested;
+        std::future<PointCloud> pending;
+    };
+
+    PLYPointCloudStreamReader::PLYPointCloudStreamReader(size_t chunk_size)
+            : chunk_size_(std::max(chunk_size, (size_t)1))
+    {}
+
+    PLYPointCloudStreamReader::PLYPointCloudStreamReader(const std::string &file_name, size_t chunk_size)
+            : chunk_size_(std::max(chunk_size, (size_t)1))
+    {
+        open(file_name);
+    }
+
+    PLYPointCloudStreamReader::~PLYPointCloudStreamReader() {
+        close();
+    }
+
+    bool PLYPointCloudStreamReader::open(const std::string &file_name) {
+        close();
+
+        std::unique_ptr<State_> state(new State_);
+        if (!state->file.open(file_name) ||
+            !parsePLYHeader(state->file.data(), state->file.size(), state->header) ||
+            !getPLYVertexLayout(state->header, state->file.size(), state->layout))
+        {
+            return false;
+        }
+        state->numRead = 0;
+        state->numRequested = 0;
+        state_ = std::move(state);
+
+        // Start decoding the first chunk right away
+        request_next_chunk_(PointCloud());
+        return true;
+    }
+
+    void PLYPointCloudStreamReader::close() {
+        if (!state_) return;
+        if (state_->pending.valid()) state_->pending.wait();
+        state_.reset();
+    }
+
+    bool PLYPointCloudStreamReader::readNextChunk(PointCloud &chunk) {
+        if (!state_ || !state_->pending.valid()) return false;
+
+        PointCloud next(state_->pending.get());
+        state_->numRead += next.points.size();
+
+        // Hand the caller's previous buffers over to the next decoding task
+        chunk.points.swap(next.points);
+        chunk.normals.swap(next.normals);
+        chunk.colors.swap(next.colors);
+        request_next_chunk_(std::move(next));
+
+        return true;
+    }
+
+    size_t PLYPointCloudStreamReader::getNumberOfPoints() const {
+        return (state_) ? state_->layout.vertex->count : 0;
+    }
+
+    size_t PLYPointCloudStreamReader::getNumberOfPointsRead() const {
+        return (state_) ? state_->numRead : 0;
+    }
+
+    bool PLYPointCloudStreamReader::hasNormals() const {
+        return state_ && state_->layout.hasNormals;
+    }
+
+    bool PLYPointCloudStreamReader::hasColors() const {
+        return state_ && state_->layout.hasColors;
+    }
+
+    void PLYPointCloudStreamReader::request_next_chunk_(PointCloud buffer) {
+        size_t num_points = state_->layout.vertex->count;
+        if (state_->numRequested >= num_points) return;
+
+        size_t begin = state_->numRequested;
+        size_t end = std::min(begin + chunk_size_, num_points);
+        state_->numRequested = end;
+
+        const char * vertex_data = state_->file.data() + state_->layout.dataOffset;
+        state_->file.prefetch(state_->layout.dataOffset + begin*state_->layout.vertex->stride, state_->layout.dataOffset + end*state_->layout.vertex->stride);
+        state_->pending = std::async(std::launch::async, readPLYVertexChunk, vertex_data, &state_->layout, &state_->file, begin, end, std::move(buffer));
+    }
+
+    namespace {
+        const char compactFileMagic[4] = {'C', 'P', 'C', '1'};
+
+        enum struct CompactPositionEncoding : uint8_t {RAW, AXIS_DELTA, MORTON_DELTA};
+
+        inline void appendBytes(std::vector<uint8_t> &buf, const void * src, size_t num_bytes) {
+            const uint8_t * ptr = (const uint8_t *)src;
+            buf.insert(buf.end(), ptr, ptr + num_bytes);
+        }
+
+        inline void appendVarint(std::vector<uint8_t> &buf, uint64_t val) {
+            while (val >= 0x80) {
+                buf.push_back((uint8_t)(val | 0x80));
+                val >>= 7;
+            }
+            buf.push_back((uint8_t)val);
+        }
 
-        std::vector<float> vertex_data(3*cloud.size());
-        std::memcpy(vertex_data.data(), cloud.points.data(), 3*cloud.size()*sizeof(float));
-        file.add_properties_to_element("vertex", {"x", "y", "z"}, vertex_data);
+        inline bool readVarint(const uint8_t *&ptr, const uint8_t * end, uint64_t &val) {
+            val = 0;
+            for (size_t shift = 0; shift < 64 && ptr < end; shift += 7) {
+                uint8_t byte = *ptr++;
+                val |= (uint64_t)(byte & 0x7F) << shift;
+                if (!(byte & 0x80)) return true;
+            }
+            return false;
+        }
+
+        inline uint64_t zigzagEncode(int64_t val) {
+            return ((uint64_t)val << 1) ^ (uint64_t)(val >> 63);
+        }
+
+        inline int64_t zigzagDecode(uint64_t val) {
+            return (int64_t)(val >> 1) ^ -(int64_t)(val & 1);
+        }
+
+        // Spreads the lower 21 bits of val to every third bit
+        inline uint64_t spreadBits3(uint64_t val) {
+            val &= 0x1FFFFF;
+            val = (val | val << 32) & 0x1F00000000FFFFULL;
+            val = (val | val << 16) & 0x1F0000FF0000FFULL;
+            val = (val | val << 8) & 0x100F00F00F00F00FULL;
+            val = (val | val << 4) & 0x10C30C30C30C30C3ULL;
+            val = (val | val << 2) & 0x1249249249249249ULL;
+            return val;
+        }
 
-        std::vector<float> normal_data;
-        if (cloud.hasNormals()) {
-            normal_data.resize(3*cloud.normals.size());
-            std::memcpy(normal_data.data(), cloud.normals.data(), 3*cloud.normals.size()*sizeof(float));
-            file.add_properties_to_element("vertex", {"nx", "ny", "nz"}, normal_data);
+        inline uint64_t compactBits3(uint64_t val) {
+            val &= 0x1249249249249249ULL;
+            val = (val ^ (val >> 2)) & 0x10C30C30C30C30C3ULL;
+            val = (val ^ (val >> 4)) & 0x100F00F00F00F00FULL;
+            val = (val ^ (val >> 8)) & 0x1F0000FF0000FFULL;
+            val = (val ^ (val >> 16)) & 0x1F00000000FFFFULL;
+            val = (val ^ (val >> 32)) & 0x1FFFFF;
+            return val;
         }
 
-        std::vector<uint8_t> color_data;
-        if (cloud.hasColors()) {
-            color_data.resize(3*cloud.colors.size());
-            for (int i = 0; i < cloud.colors.size(); i++) {
-                color_data[3 * i + 0] = (uint8_t)(cloud.colors[i](0)*255.0f);
-                color_data[3 * i + 1] = (uint8_t)(cloud.colors[i](1)*255.0f);
-                color_data[3 * i + 2] = (uint8_t)(cloud.colors[i](2)*255.0f);
+        inline Eigen::Vector2f octahedralEncode(const Eigen::Vector3f &n) {
+            float l1 = std::abs(n(0)) + std::abs(n(1)) + std::abs(n(2));
+            if (l1 == 0.0f || !std::isfinite(l1)) return Eigen::Vector2f(0.0f, 0.0f);
+            Eigen::Vector2f e(n(0)/l1, n(1)/l1);
+            if (n(2) < 0.0f) {
+                e = Eigen::Vector2f((1.0f - std::abs(e(1)))*((e(0) >= 0.0f) ? 1.0f : -1.0f),
+                                    (1.0f - std::abs(e(0)))*((e(1) >= 0.0f) ? 1.0f : -1.0f));
             }
-            file.add_properties_to_element("vertex", {"red", "green", "blue"}, color_data);
+            return e;
         }
 
-        // Write to file
-        std::filebuf fb;
-        fb.open(filename, std::ios::out | std::ios::binary);
-        std::ostream output_stream(&fb);
-        file.write(output_stream, binary);
-        fb.close();
+        inline Eigen::Vector3f octahedralDecode(const Eigen::Vector2f &e) {
+            Eigen::Vector3f n(e(0), e(1), 1.0f - std::abs(e(0)) - std::abs(e(1)));
+            if (n(2) < 0.0f) {
+                n(0) = (1.0f - std::abs(e(1)))*((e(0) >= 0.0f) ? 1.0f : -1.0f);
+                n(1) = (1.0f - std::abs(e(0)))*((e(1) >= 0.0f) ? 1.0f : -1.0f);
+            }
+            float norm = n.norm();
+            return (norm > 0.0f) ? Eigen::Vector3f(n/norm) : n;
+        }
+
+        inline int16_t toSnorm16(float val) {
+            return (int16_t)std::round(std::min(std::max(val, -1.0f), 1.0f)*32767.0f);
+        }
+
+        void encodeCompactChunk(const PointCloud &cloud,
+                                size_t begin, size_t end,
+                                float step, bool morton_order,
+                                std::vector<uint8_t> &buf)
+        {
+            size_t num = end - begin;
+            bool has_normals = cloud.hasNormals();
+            bool has_colors = cloud.hasColors();
+
+            // Pick the position encoding this chunk admits
+            CompactPositionEncoding encoding = CompactPositionEncoding::RAW;
+            Eigen::Vector3f origin(0.0f, 0.0f, 0.0f);
+            if (step > 0.0f) {
+                Eigen::Vector3f min_pt(cloud.points[begin]), max_pt(cloud.points[begin]);
+                bool finite = true;
+                for (size_t i = begin; i < end; i++) {
+                    if (!cloud.points[i].allFinite()) {
+                        finite = false;
+                        break;
+                    }
+                    min_pt = min_pt.cwiseMin(cloud.points[i]);
+                    max_pt = max_pt.cwiseMax(cloud.points[i]);
+                }
+                if (finite) {
+                    origin = min_pt;
+                    double max_extent = ((max_pt.cast<double>() - min_pt.cast<double>())/step).maxCoeff();
+                    if (morton_order && max_extent < (double)((1 << 21) - 1)) {
+                        encoding = CompactPositionEncoding::MORTON_DELTA;
+                    } else if (max_extent < 4294967295.0) {
+                        encoding = CompactPositionEncoding::AXIS_DELTA;
+                    }
+                }
+            }
+
+            std::vector<size_t> order(num);
+            for (size_t i = 0; i < num; i++) order[i] = begin + i;
+
+            buf.clear();
+            uint32_t num32 = num;
+            appendBytes(buf, &num32, sizeof(uint32_t));
+            buf.push_back((uint8_t)encoding);
+
+            if (encoding == CompactPositionEncoding::RAW) {
+                for (size_t i = begin; i < end; i++) appendBytes(buf, cloud.points[i].data(), 3*sizeof(float));
+            } else {
+                appendBytes(buf, origin.data(), 3*sizeof(float));
+                // In double precision: quantized coordinates can exceed the float mantissa
+                std::vector<Eigen::Matrix<uint32_t,3,1> > quantized(num);
+                for (size_t i = 0; i < num; i++) {
+                    Eigen::Vector3d q = ((cloud.points[begin + i].cast<double>() - origin.cast<double>())/step).array().round().matrix();
+                    quantized[i] = q.cwiseMax(0.0).cast<uint32_t>();
+                }
+
+                if (encoding == CompactPositionEncoding::MORTON_DELTA) {
+                    std::vector<std::pair<uint64_t,size_t> > codes(num);
+                    for (size_t i = 0; i < num; i++) {
+                        codes[i].first = spreadBits3(quantized[i](0)) | (spreadBits3(quantized[i](1)) << 1) | (spreadBits3(quantized[i](2)) << 2);
+                        codes[i].second = i;
+                    }
+                    std::sort(codes.begin(), codes.end());
+                    uint64_t prev = 0;
+                    for (size_t i = 0; i < num; i++) {
+                        appendVarint(buf, codes[i].first - prev);
+                        prev = codes[i].first;
+                        order[i] = begin + codes[i].second;
+                    }
+                } else {
+                    int64_t prev[3] = {0, 0, 0};
+                    for (size_t i = 0; i < num; i++) {
+                        for (size_t k = 0; k < 3; k++) {
+                            appendVarint(buf, zigzagEncode((int64_t)quantized[i](k) - prev[k]));
+                            prev[k] = quantized[i](k);
+                        }
+                    }
+                }
+            }
+
+            if (has_normals) {
+                for (size_t i = 0; i < num; i++) {
+                    Eigen::Vector2f e = octahedralEncode(cloud.normals[order[i]]);
+                    int16_t packed[2] = {toSnorm16(e(0)), toSnorm16(e(1))};
+                    appendBytes(buf, packed, sizeof(packed));
+                }
+            }
+            if (has_colors) {
+                for (size_t i = 0; i < num; i++) {
+                    uint8_t packed[3] = {colorToByte(cloud.colors[order[i]](0)), colorToByte(cloud.colors[order[i]](1)), colorToByte(cloud.colors[order[i]](2))};
+                    appendBytes(buf, packed, sizeof(packed));
+                }
+            }
+        }
+
+        bool decodeCompactChunk(const uint8_t * ptr, const uint8_t * end,
+                                float step, bool has_normals, bool has_colors,
+                                size_t num_expected,
+                                Eigen::Vector3f * points,
+                                Eigen::Vector3f * normals,
+                                Eigen::Vector3f * colors)
+        {
+            if (end - ptr < (ptrdiff_t)(sizeof(uint32_t) + 1)) return false;
+            uint32_t num;
+            std::memcpy(&num, ptr, sizeof(uint32_t));
+            ptr += sizeof(uint32_t);
+            CompactPositionEncoding encoding = (CompactPositionEncoding)(*ptr++);
+            if (num != num_expected) return false;
+
+            if (encoding == CompactPositionEncoding::RAW) {
+                if (end - ptr < (ptrdiff_t)(3*num*sizeof(float))) return false;
+                std::memcpy((void *)points, ptr, 3*num*sizeof(float));
+                ptr += 3*num*sizeof(float);
+            } else {
+                if (end - ptr < (ptrdiff_t)(3*sizeof(float))) return false;
+                Eigen::Vector3f origin;
+                std::memcpy(origin.data(), ptr, 3*sizeof(float));
+                ptr += 3*sizeof(float);
+
+                if (encoding == CompactPositionEncoding::MORTON_DELTA) {
+                    uint64_t code = 0, delta;
+                    for (size_t i = 0; i < num; i++) {
+                        if (!readVarint(ptr, end, delta)) return false;
+                        code += delta;
+                        Eigen::Vector3d q((double)compactBits3(code), (double)compactBits3(code >> 1), (double)compactBits3(code >> 2));
+                        points[i] = (origin.cast<double>() + (double)step*q).cast<float>();
+                    }
+                } else if (encoding == CompactPositionEncoding::AXIS_DELTA) {
+                    // Deltas accumulate as integers; positions are rebuilt in double and rounded to float once
+                    int64_t prev[3] = {0, 0, 0};
+                    uint64_t delta;
+                    for (size_t i = 0; i < num; i++) {
+                        for (size_t k = 0; k < 3; k++) {
+                            if (!readVarint(ptr, end, delta)) return false;
+                            prev[k] += zigzagDecode(delta);
+                            points[i](k) = (float)((double)origin(k) + (double)step*(double)prev[k]);
+                        }
+                    }
+                } else {
+                    return false;
+                }
+            }
+
+            if (has_normals) {
+                if (end - ptr < (ptrdiff_t)(2*num*sizeof(int16_t))) return false;
+                for (size_t i = 0; i < num; i++) {
+                    int16_t packed[2];
+                    std::memcpy(packed, ptr, sizeof(packed));
+                    ptr += sizeof(packed);
+                    normals[i] = octahedralDecode(Eigen::Vector2f(packed[0], packed[1])/32767.0f);
+                }
+            }
+            if (has_colors) {
+                if (end - ptr < (ptrdiff_t)(3*num)) return false;
+                for (size_t i = 0; i < num; i++) {
+                    colors[i] = Eigen::Vector3f(ptr[0], ptr[1], ptr[2])/255.0f;
+                    ptr += 3;
+                }
+            }
+            return true;
+        }
+    }
+
+    bool writePointCloudToCompactFile(const std::string &file_name,
+                                      const PointCloud &cloud,
+                                      float position_quantization_step,
+                                      bool morton_order,
+                                      size_t chunk_size)
+    {
+        chunk_size = std::max(chunk_size, (size_t)1);
+        uint64_t num_points = cloud.size();
+        uint64_t num_chunks = (num_points + chunk_size - 1)/chunk_size;
+        float step = std::max(position_quantization_step, 0.0f);
+
+        std::vector<std::vector<uint8_t> > chunks(num_chunks);
+#pragma omp parallel for schedule(dynamic)
+        for (size_t c = 0; c < num_chunks; c++) {
+            encodeCompactChunk(cloud, c*chunk_size, std::min((c + 1)*chunk_size, (size_t)num_points), step, morton_order, chunks[c]);
+        }
+
+        // Header, chunk size table, chunk payloads
+        std::ofstream out(file_name, std::ios::out | std::ios::binary);
+        if (!out) return false;
+        uint8_t flags = (cloud.hasNormals() ? 1 : 0) | (cloud.hasColors() ? 2 : 0);
+        uint64_t chunk_size64 = chunk_size;
+        out.write(compactFileMagic, sizeof(compactFileMagic));
+        out.write((char*)&num_points, sizeof(uint64_t));
+        out.write((char*)&chunk_size64, sizeof(uint64_t));
+        out.write((char*)&step, sizeof(float));
+        out.write((char*)&flags, sizeof(uint8_t));
+        for (size_t c = 0; c < num_chunks; c++) {
+            uint64_t chunk_bytes = chunks[c].size();
+            out.write((char*)&chunk_bytes, sizeof(uint64_t));
+        }
+        for (size_t c = 0; c < num_chunks; c++) {
+            out.write((char*)chunks[c].data(), chunks[c].size());
+        }
+        out.close();
+        return !out.fail();
+    }
+
+    bool readPointCloudFromCompactFile(const std::string &file_name, PointCloud &cloud) {
+        MemoryMappedFile file(file_name);
+        const size_t header_size = sizeof(compactFileMagic) + 2*sizeof(uint64_t) + sizeof(float) + sizeof(uint8_t);
+        if (!file.isOpen() || file.size() < header_size || std::memcmp(file.data(), compactFileMagic, sizeof(compactFileMagic)) != 0) return false;
+        file.prefetch(0, file.size());
+
+        const char * ptr = file.data() + sizeof(compactFileMagic);
+        uint64_t num_points, chunk_size;
+        float step;
+        uint8_t flags;
+        std::memcpy(&num_points, ptr, sizeof(uint64_t));
+        ptr += sizeof(uint64_t);
+        std::memcpy(&chunk_size, ptr, sizeof(uint64_t));
+        ptr += sizeof(uint64_t);
+        std::memcpy(&step, ptr, sizeof(float));
+        ptr += sizeof(float);
+        std::memcpy(&flags, ptr, sizeof(uint8_t));
+        ptr += sizeof(uint8_t);
+        if (chunk_size == 0) return false;
+
+        uint64_t num_chunks = (num_points + chunk_size - 1)/chunk_size;
+        if ((file.size() - header_size)/sizeof(uint64_t) < num_chunks) return false;
+
+        // Chunk offsets from the size table
+        std::vector<size_t> chunk_offsets(num_chunks + 1);
+        chunk_offsets[0] = header_size + num_chunks*sizeof(uint64_t);
+        for (size_t c = 0; c < num_chunks; c++) {
+            uint64_t chunk_bytes;
+            std::memcpy(&chunk_bytes, ptr + c*sizeof(uint64_t), sizeof(uint64_t));
+            chunk_offsets[c + 1] = chunk_offsets[c] + chunk_bytes;
+        }
+        if (chunk_offsets[num_chunks] > file.size()) return false;
+
+        bool has_normals = flags & 1;
+        bool has_colors = flags & 2;
+        cloud.points.resize(num_points);
+        cloud.normals.resize((has_normals) ? num_points : 0);
+        cloud.colors.resize((has_colors) ? num_points : 0);
+
+        const uint8_t * data = (const uint8_t *)file.data();
+        bool success = true;
+#pragma omp parallel for schedule(dynamic) reduction(&&: success)
+        for (size_t c = 0; c < num_chunks; c++) {
+            size_t begin = c*chunk_size;
+            size_t num = std::min((size_t)chunk_size, (size_t)num_points - begin);
+            success = decodeCompactChunk(data + chunk_offsets[c], data + chunk_offsets[c + 1], step, has_normals, has_colors, num,
+                                         cloud.points.data() + begin,
+                                         (has_normals) ? cloud.normals.data() + begin : NULL,
+                                         (has_colors) ? cloud.colors.data() + begin : NULL) && success;
+        }
+
+        if (!success) cloud.clear();
+        return success;
+    }
+
+    namespace {
+        inline bool isASCIISeparator(char c) {
+            return c == ' ' || c == '\t' || c == ',' || c == ';' || c == '\r';
+        }
+
+        inline bool isASCIITokenEnd(char c) {
+            return isASCIISeparator(c) || c == '\n' || c == '#';
+        }
+
+        inline const char * skipASCIILine(const char * ptr, const char * end) {
+            const char * nl = (const char *)std::memchr(ptr, '\n', end - ptr);
+            return (nl == NULL) ? end : nl + 1;
+        }
+
+        // Exact conversion when the decimal mantissa and exponent are small enough (Clinger's fast path)
+        bool parseASCIIDoubleFast(const char * ptr, const char * end, double &val) {
+            static const double pow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                           1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+            bool negative = false;
+            if (ptr < end && (*ptr == '-' || *ptr == '+')) negative = *ptr++ == '-';
+
+            uint64_t mantissa = 0;
+            int num_digits = 0, exponent = 0;
+            bool any_digits = false;
+            while (ptr < end && *ptr >= '0' && *ptr <= '9') {
+                if (num_digits >= 19) return false;
+                mantissa = 10*mantissa + (*ptr++ - '0');
+                if (mantissa > 0) num_digits++;
+                any_digits = true;
+            }
+            if (ptr < end && *ptr == '.') {
+                ptr++;
+                while (ptr < end && *ptr >= '0' && *ptr <= '9') {
+                    if (num_digits >= 19) return false;
+                    mantissa = 10*mantissa + (*ptr++ - '0');
+                    if (mantissa > 0) num_digits++;
+                    exponent--;
+                    any_digits = true;
+                }
+            }
+            if (!any_digits) return false;
+
+            if (ptr < end && (*ptr == 'e' || *ptr == 'E')) {
+                ptr++;
+                bool exp_negative = false;
+                if (ptr < end && (*ptr == '-' || *ptr == '+')) exp_negative = *ptr++ == '-';
+                if (ptr == end || *ptr < '0' || *ptr > '9') return false;
+                int exp_val = 0;
+                while (ptr < end && *ptr >= '0' && *ptr <= '9') {
+                    if (exp_val > 10000) return false;
+                    exp_val = 10*exp_val + (*ptr++ - '0');
+                }
+                exponent += (exp_negative) ? -exp_val : exp_val;
+            }
+            if (ptr != end) return false;
+
+            if (mantissa > ((uint64_t)1 << 53) || exponent < -22 || exponent > 22) return false;
+            val = (double)mantissa;
+            val = (exponent < 0) ? val/pow10[-exponent] : val*pow10[exponent];
+            if (negative) val = -val;
+            return true;
+        }
+    }
+
+    namespace internal {
+        void splitASCIIIntoRanges(const char * data, size_t size, size_t range_size, std::vector<size_t> &bounds) {
+            bounds.assign(1, 0);
+            size_t pos = std::max(range_size, (size_t)1);
+            while (pos < size) {
+                size_t next = skipASCIILine(data + pos, data + size) - data;
+                if (next >= size) break;
+                bounds.emplace_back(next);
+                pos = next + range_size;
+            }
+            bounds.emplace_back(size);
+        }
+
+        size_t countASCIIRows(const char * begin, const char * end) {
+            size_t count = 0;
+            while (skipToASCIIRow(begin, end)) {
+                count++;
+                begin = skipASCIILine(begin, end);
+            }
+            return count;
+        }
+
+        size_t countASCIIFirstRowValues(const char * begin, const char * end) {
+            if (!skipToASCIIRow(begin, end)) return 0;
+            size_t count = 0;
+            while (true) {
+                while (begin < end && isASCIISeparator(*begin)) begin++;
+                if (begin == end || *begin == '\n' || *begin == '#') break;
+                count++;
+                while (begin < end && !isASCIITokenEnd(*begin)) begin++;
+            }
+            return count;
+        }
+
+        bool skipToASCIIRow(const char *&ptr, const char * end) {
+            while (ptr < end) {
+                if (isASCIISeparator(*ptr)) {
+                    ptr++;
+                } else if (*ptr == '\n') {
+                    ptr++;
+                } else if (*ptr == '#') {
+                    ptr = skipASCIILine(ptr, end);
+                } else {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool finishASCIIRow(const char *&ptr, const char * end) {
+            while (ptr < end && isASCIISeparator(*ptr)) ptr++;
+            if (ptr == end) return true;
+            if (*ptr != '\n' && *ptr != '#') return false;
+            ptr = skipASCIILine(ptr, end);
+            return true;
+        }
+
+        bool parseASCIIValue(const char *&ptr, const char * end, double &val) {
+            while (ptr < end && isASCIISeparator(*ptr)) ptr++;
+            const char * token_end = ptr;
+            while (token_end < end && !isASCIITokenEnd(*token_end)) token_end++;
+            if (token_end == ptr) return false;
+
+            if (!parseASCIIDoubleFast(ptr, token_end, val)) {
+                // Long mantissas, large exponents, nan/inf
+                char buf[64];
+                size_t len = token_end - ptr;
+                if (len >= sizeof(buf)) return false;
+                std::memcpy(buf, ptr, len);
+                buf[len] = '\0';
+                char * parsed_end;
+                val = std::strtod(buf, &parsed_end);
+                if (parsed_end != buf + len) return false;
+            }
+            ptr = token_end;
+            return true;
+        }
     }
 
     size_t getFileSizeInBytes(const std::string &file_name) {
@@ -0,0 +1,303 @@
+#include <cilantro/marching_cubes.hpp>
+#include <cilantro/cartesian_grid.hpp>
+#include <unordered_map>
+#include <algorithm>
+#include <bitset>
+#include <limits>
+#include <cmath>
+
+namespace cilantro {
+    namespace {
+        inline size_t cubeEdgeIndex(size_t c0, size_t c1) {
+            size_t start = std::min(c0, c1);
+            size_t axis = ((c0 ^ c1) == 1) ? 0 : (((c0 ^ c1) == 2) ? 1 : 2);
+            return axis*4 + ((start & ((1 << axis) - 1)) | ((start >> (axis + 1)) << axis));
+        }
+
+        inline size_t cubeEdgeStartCorner(size_t edge) {
+            size_t axis = edge/4, k = edge%4;
+            return (k & ((1 << axis) - 1)) | ((k >> axis) << (axis + 1));
+        }
+
+        // Traces the iso-contour around the cube faces and fans the resulting loops. Ambiguous faces always separate
+        // their inside corners, which keeps the surface watertight across cubes.
+        std::vector<std::vector<unsigned char> > generateMarchingCubesTriangleTable() {
+            // Face corners in counter-clockwise order when viewed from outside the cube
+            const size_t faces[6][4] = {{0,4,6,2}, {1,3,7,5}, {0,1,5,4}, {2,6,7,3}, {0,2,3,1}, {4,5,7,6}};
+
+            std::vector<std::vector<unsigned char> > triangles(256);
+            for (size_t config = 0; config < 256; config++) {
+                int next[12];
+                std::fill(next, next + 12, -1);
+                for (size_t f = 0; f < 6; f++) {
+                    bool inside[4];
+                    for (size_t i = 0; i < 4; i++) inside[i] = (config >> faces[f][i]) & 1;
+                    for (size_t i = 0; i < 4; i++) {
+                        // Contour enters the inside region between corners i and i+1 and leaves at the next exit
+                        if (inside[i] || !inside[(i+1)%4]) continue;
+                        size_t j = (i+1)%4;
+                        while (!(inside[j] && !inside[(j+1)%4])) j = (j+1)%4;
+                        next[cubeEdgeIndex(faces[f][j], faces[f][(j+1)%4])] = (int)cubeEdgeIndex(faces[f][i], faces[f][(i+1)%4]);
+                    }
+                }
+
+                bool visited[12] = {false};
+                for (size_t e = 0; e < 12; e++) {
+                    if (next[e] < 0 || visited[e]) continue;
+                    std::vector<unsigned char> loop;
+                    size_t curr = e;
+                    while (!visited[curr]) {
+                        visited[curr] = true;
+                        loop.emplace_back((unsigned char)curr);
+                        curr = (size_t)next[curr];
+                    }
+                    for (size_t i = 1; i + 1 < loop.size(); i++) {
+                        triangles[config].emplace_back(loop[0]);
+                        triangles[config].emplace_back(loop[i+1]);
+                        triangles[config].emplace_back(loop[i]);
+                    }
+                }
+            }
+            return triangles;
+        }
+
+        // Index of the block holding local node (x,y,z) of block b, with coordinates in [0,res], and the node's index
+        // within it; neighbors holds the indices of the blocks at each offset in {0,1}^3 from every block
+        inline size_t locateBlockNode(const std::vector<size_t> &neighbors, size_t b, ptrdiff_t res, ptrdiff_t x, ptrdiff_t y, ptrdiff_t z, size_t &ind) {
+            ind = (size_t)((x%res) + res*((y%res) + res*(z%res)));
+            return neighbors[8*b + ((x == res) | ((y == res) << 1) | ((z == res) << 2))];
+        }
+
+        // Each block owns the 3 grid edges starting at each of its nodes (edge id node*3 + axis) and stores the
+        // vertices of its crossed edges in edge id order. A vertex's index within its block is the rank of its edge in
+        // the block's crossing bitmask, so that faces can reference vertices of any block once the per block vertex
+        // counts have been prefix-summed.
+        struct BlockEdgeCrossings {
+            std::vector<uint64_t> mask;
+            std::vector<size_t> rank;
+            std::vector<Eigen::Vector3f> vertices;
+            std::vector<Eigen::Vector3f> attributes;
+
+            inline size_t getVertexIndex(size_t edge) const {
+                return rank[edge/64] + std::bitset<64>(mask[edge/64] & ((uint64_t(1) << (edge%64)) - 1)).count();
+            }
+        };
+
+        void extractMarchingCubesMesh(const std::vector<Eigen::Matrix<ptrdiff_t,3,1> > &block_coordinates,
+                                      const std::vector<const float*> &block_values,
+                                      const std::vector<const Eigen::Vector3f*> *block_attributes,
+                                      size_t block_resolution,
+                                      float node_spacing,
+                                      float iso_value,
+                                      std::vector<Eigen::Vector3f> &vertices,
+                                      std::vector<std::vector<size_t> > &faces,
+                                      std::vector<Eigen::Vector3f> *vertex_attributes)
+        {
+            vertices.clear();
+            faces.clear();
+            if (vertex_attributes != NULL) vertex_attributes->clear();
+
+            const size_t num_blocks = std::min(block_coordinates.size(), block_values.size());
+            if (num_blocks == 0 || block_resolution == 0) return;
+            if (block_attributes != NULL && block_attributes->size() < num_blocks) return;
+
+            const ptrdiff_t res = (ptrdiff_t)block_resolution;
+            const size_t num_edges = 3*block_resolution*block_resolution*block_resolution;
+            const size_t num_words = (num_edges + 63)/64;
+            const std::vector<std::vector<unsigned char> > &triangles(getMarchingCubesTriangleTable());
+
+            std::unordered_map<Eigen::Matrix<ptrdiff_t,3,1>,size_t,EigenVectorHash<ptrdiff_t,3> > block_lookup;
+            block_lookup.reserve(num_blocks);
+            for (size_t b = 0; b < num_blocks; b++) {
+                block_lookup.emplace(block_coordinates[b], b);
+            }
+
+            // Indices of the blocks at each offset in {0,1}^3 (indexed by its bits); num_blocks if missing
+            std::vector<size_t> neighbors(8*num_blocks);
+#pragma omp parallel for
+            for (size_t b = 0; b < num_blocks; b++) {
+                neighbors[8*b] = b;
+                for (size_t c = 1; c < 8; c++) {
+                    auto it = block_lookup.find(block_coordinates[b] + Eigen::Matrix<ptrdiff_t,3,1>(c & 1, (c >> 1) & 1, (c >> 2) & 1));
+                    neighbors[8*b + c] = (it == block_lookup.end()) ? num_blocks : it->second;
+                }
+            }
+
+            // Node index offsets of the cube corners within a block
+            size_t corner_offsets[8];
+            for (size_t c = 0; c < 8; c++) {
+                corner_offsets[c] = (size_t)((c & 1) + res*(((c >> 1) & 1) + res*((c >> 2) & 1)));
+            }
+
+            // Per block vertices of all crossed edges with two observed endpoints
+            std::vector<BlockEdgeCrossings> crossings(num_blocks);
+#pragma omp parallel for schedule (dynamic)
+            for (size_t b = 0; b < num_blocks; b++) {
+                BlockEdgeCrossings &bc = crossings[b];
+                bc.mask.assign(num_words, 0);
+                bc.rank.resize(num_words);
+                const Eigen::Vector3f base(node_spacing*(res*block_coordinates[b]).cast<float>());
+                size_t edge = 0;
+                for (ptrdiff_t z = 0; z < res; z++) {
+                    for (ptrdiff_t y = 0; y < res; y++) {
+                        for (ptrdiff_t x = 0; x < res; x++) {
+                            const size_t ind0 = (size_t)(x + res*(y + res*z));
+                            const float v0 = block_values[b][ind0];
+                            const ptrdiff_t coords[3] = {x, y, z};
+                            for (size_t a = 0; a < 3; a++, edge++) {
+                                if (std::isnan(v0)) continue;
+                                size_t ind1 = ind0 + corner_offsets[(size_t)1 << a];
+                                const size_t nb = (coords[a] + 1 < res) ? b : locateBlockNode(neighbors, b, res, x + (a == 0), y + (a == 1), z + (a == 2), ind1);
+                                if (nb == num_blocks) continue;
+                                const float v1 = block_values[nb][ind1];
+                                if (std::isnan(v1) || (v0 < iso_value) == (v1 < iso_value)) continue;
+
+                                const float t = (iso_value - v0)/(v1 - v0);
+                                Eigen::Vector3f vertex(base + node_spacing*Eigen::Vector3f(x, y, z));
+                                vertex[a] += t*node_spacing;
+                                bc.mask[edge/64] |= uint64_t(1) << (edge%64);
+                                bc.vertices.emplace_back(vertex);
+                                if (block_attributes != NULL) {
+                                    bc.attributes.emplace_back((1.0f - t)*(*block_attributes)[b][ind0] + t*(*block_attributes)[nb][ind1]);
+                                }
+                            }
+                        }
+                    }
+                }
+                size_t count = 0;
+                for (size_t w = 0; w < num_words; w++) {
+                    bc.rank[w] = count;
+                    count += std::bitset<64>(bc.mask[w]).count();
+                }
+            }
+
+            // Global stitch: vertex offsets of the blocks
+            std::vector<size_t> vertex_offsets(num_blocks + 1, 0);
+            for (size_t b = 0; b < num_blocks; b++) {
+                vertex_offsets[b+1] = vertex_offsets[b] + crossings[b].vertices.size();
+            }
+
+            // Triangulate the cubes whose origin node lies in each block
+            std::vector<std::vector<std::vector<size_t> > > block_faces(num_blocks);
+#pragma omp parallel for schedule (dynamic)
+            for (size_t b = 0; b < num_blocks; b++) {
+                float values[8];
+                size_t blocks[8], inds[8];
+                for (ptrdiff_t z = 0; z < res; z++) {
+                    for (ptrdiff_t y = 0; y < res; y++) {
+                        for (ptrdiff_t x = 0; x < res; x++) {
+                            const bool interior = x + 1 < res && y + 1 < res && z + 1 < res;
+                            const size_t ind0 = (size_t)(x + res*(y + res*z));
+                            size_t config = 0, c;
+                            for (c = 0; c < 8; c++) {
+                                if (interior) {
+                                    blocks[c] = b;
+                                    inds[c] = ind0 + corner_offsets[c];
+                                } else {
+                                    blocks[c] = locateBlockNode(neighbors, b, res, x + (c & 1), y + ((c >> 1) & 1), z + ((c >> 2) & 1), inds[c]);
+                                }
+                                if (blocks[c] == num_blocks) break;
+                                values[c] = block_values[blocks[c]][inds[c]];
+                                if (std::isnan(values[c])) break;
+                                if (values[c] < iso_value) config |= (size_t)1 << c;
+                            }
+                            if (c < 8 || triangles[config].empty()) continue;
+
+                            for (size_t i = 0; i < triangles[config].size(); i += 3) {
+                                std::vector<size_t> face(3);
+                                for (size_t j = 0; j < 3; j++) {
+                                    const size_t e = triangles[config][i+j];
+                                    const size_t c0 = cubeEdgeStartCorner(e);
+                                    face[j] = vertex_offsets[blocks[c0]] + crossings[blocks[c0]].getVertexIndex(3*inds[c0] + e/4);
+                                }
+                                block_faces[b].emplace_back(std::move(face));
+                            }
+                        }
+                    }
+                }
+            }
+
+            std::vector<size_t> face_offsets(num_blocks + 1, 0);
+            for (size_t b = 0; b < num_blocks; b++) {
+                face_offsets[b+1] = face_offsets[b] + block_faces[b].size();
+            }
+
+            vertices.resize(vertex_offsets[num_blocks]);
+            faces.resize(face_offsets[num_blocks]);
+            if (vertex_attributes != NULL) vertex_attributes->resize(vertex_offsets[num_blocks]);
+#pragma omp parallel for
+            for (size_t b = 0; b < num_blocks; b++) {
+                std::copy(crossings[b].vertices.begin(), crossings[b].vertices.end(), vertices.begin() + vertex_offsets[b]);
+                if (vertex_attributes != NULL) {
+                    std::copy(crossings[b].attributes.begin(), crossings[b].attributes.end(), vertex_attributes->begin() + vertex_offsets[b]);
+                }
+                std::move(block_faces[b].begin(), block_faces[b].end(), faces.begin() + face_offsets[b]);
+            }
+        }
+    }
+
+    const std::vector<std::vector<unsigned char> >& getMarchingCubesTriangleTable() {
+        static const std::vector<std::vector<unsigned char> > triangles(generateMarchingCubesTriangleTable());
+        return triangles;
+    }
+
+    void marchingCubes(const std::vector<Eigen::Matrix<ptrdiff_t,3,1> > &block_coordinates,
+                       const std::vector<const float*> &block_values,
+                       size_t block_resolution,
+                       float node_spacing,
+                       float iso_value,
+                       std::vector<Eigen::Vector3f> &vertices,
+                       std::vector<std::vector<size_t> > &faces)
+    {
+        extractMarchingCubesMesh(block_coordinates, block_values, NULL, block_resolution, node_spacing, iso_value, vertices, faces, NULL);
+    }
+
+    void marchingCubes(const std::vector<Eigen::Matrix<ptrdiff_t,3,1> > &block_coordinates,
+                       const std::vector<const float*> &block_values,
+                       const std::vector<const Eigen::Vector3f*> &block_attributes,
+                       size_t block_resolution,
+                       float node_spacing,
+                       float iso_value,
+                       std::vector<Eigen::Vector3f> &vertices,
+                       std::vector<std::vector<size_t> > &faces,
+                       std::vector<Eigen::Vector3f> &vertex_attributes)
+    {
+        extractMarchingCubesMesh(block_coordinates, block_values, &block_attributes, block_resolution, node_spacing, iso_value, vertices, faces, &vertex_attributes);
+    }
+
+    void marchingCubes(const float *values,
+                       size_t size_x,
+                       size_t size_y,
+                       size_t size_z,
+                       float node_spacing,
+                       const Eigen::Vector3f &origin,
+                       float iso_value,
+                       std::vector<Eigen::Vector3f> &vertices,
+                       std::vector<std::vector<size_t> > &faces)
+    {
+        // Copy into NaN padded blocks
+        const size_t res = 16, block_size = res*res*res;
+        const size_t blocks_x = (size_x + res - 1)/res, blocks_y = (size_y + res - 1)/res, blocks_z = (size_z + res - 1)/res;
+        const size_t num_blocks = blocks_x*blocks_y*blocks_z;
+
+        std::vector<float> block_data(num_blocks*block_size, std::numeric_limits<float>::quiet_NaN());
+        std::vector<Eigen::Matrix<ptrdiff_t,3,1> > block_coordinates(num_blocks);
+        std::vector<const float*> block_values(num_blocks);
+#pragma omp parallel for
+        for (size_t b = 0; b < num_blocks; b++) {
+            const size_t bx = b%blocks_x, by = (b/blocks_x)%blocks_y, bz = b/(blocks_x*blocks_y);
+            block_coordinates[b] = Eigen::Matrix<ptrdiff_t,3,1>(bx, by, bz);
+            block_values[b] = &block_data[b*block_size];
+            float *block = &block_data[b*block_size];
+            for (size_t z = 0; z < res && bz*res + z < size_z; z++) {
+                for (size_t y = 0; y < res && by*res + y < size_y; y++) {
+                    const float *src = values + ((bz*res + z)*size_y + by*res + y)*size_x + bx*res;
+                    std::copy(src, src + std::min(res, size_x - bx*res), block + (z*res + y)*res);
+                }
+            }
+        }
+
+        extractMarchingCubesMesh(block_coordinates, block_values, NULL, res, node_spacing, iso_value, vertices, faces, NULL);
+        for (size_t i = 0; i < vertices.size(); i++) vertices[i] += origin;
+    }
+}
@@ -48,6 +48,30 @@ namespace cilantro {
         }
     }
 
+    PointCloud::PointCloud(const PointCloud &cloud, const std::vector<bool> &mask, bool negate) {
+        size_t num_selected = 0;
+        for (size_t i = 0; i < cloud.size(); i++) {
+            if (mask[i] != negate) num_selected++;
+        }
+
+        points.reserve(num_selected);
+        for (size_t i = 0; i < cloud.size(); i++) {
+            if (mask[i] != negate) points.emplace_back(cloud.points[i]);
+        }
+        if (cloud.hasNormals()) {
+            normals.reserve(num_selected);
+            for (size_t i = 0; i < cloud.size(); i++) {
+                if (mask[i] != negate) normals.emplace_back(cloud.normals[i]);
+            }
+        }
+        if (cloud.hasColors()) {
+            colors.reserve(num_selected);
+            for (size_t i = 0; i < cloud.size(); i++) {
+                if (mask[i] != negate) colors.emplace_back(cloud.colors[i]);
+            }
+        }
+    }
+
     PointCloud& PointCloud::clear() {
         points.clear();
         normals.clear();
@@ -113,6 +137,28 @@ namespace cilantro {
         return *this;
     }
 
+    PointCloud& PointCloud::select(const std::vector<bool> &mask) {
+        bool has_normals = hasNormals();
+        bool has_colors = hasColors();
+
+        size_t k = 0;
+        for (size_t i = 0; i < size(); i++) {
+            if (!mask[i]) continue;
+            if (k < i) {
+                points[k] = points[i];
+                if (has_normals) normals[k] = normals[i];
+                if (has_colors) colors[k] = colors[i];
+            }
+            k++;
+        }
+
+        points.resize(k);
+        if (has_normals) normals.resize(k);
+        if (has_colors) colors.resize(k);
+
+        return *this;
+    }
+
     PointCloud& PointCloud::removeInvalidPoints() {
         std::vector<size_t> ind_to_remove;
         ind_to_remove.reserve(points.size());
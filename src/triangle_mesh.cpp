@@ -0,0 +1,229 @@
+#include <cilantro/triangle_mesh.hpp>
+
+namespace cilantro {
+    TriangleMesh::TriangleMesh() {}
+
+    TriangleMesh::TriangleMesh(const std::vector<Eigen::Vector3f> &vertices, const std::vector<Face> &faces)
+            : vertices(vertices),
+              faces(faces)
+    {}
+
+    TriangleMesh::TriangleMesh(const std::vector<Eigen::Vector3f> &vertices, const std::vector<std::vector<size_t> > &faces)
+            : vertices(vertices)
+    {
+        size_t num_triangles = 0;
+        for (size_t i = 0; i < faces.size(); i++) {
+            if (faces[i].size() > 2) num_triangles += faces[i].size() - 2;
+        }
+        this->faces.reserve(num_triangles);
+        for (size_t i = 0; i < faces.size(); i++) {
+            for (size_t j = 2; j < faces[i].size(); j++) {
+                this->faces.emplace_back(faces[i][0], faces[i][j-1], faces[i][j]);
+            }
+        }
+    }
+
+    TriangleMesh::TriangleMesh(const PointCloud &cloud, const std::vector<Face> &faces)
+            : vertices(cloud.points),
+              faces(faces)
+    {
+        if (cloud.hasNormals()) vertexNormals = cloud.normals;
+        if (cloud.hasColors()) vertexColors = cloud.colors;
+    }
+
+    TriangleMesh& TriangleMesh::clear() {
+        vertices.clear();
+        vertexNormals.clear();
+        vertexColors.clear();
+        faces.clear();
+        return *this;
+    }
+
+    TriangleMesh& TriangleMesh::append(const TriangleMesh &mesh) {
+        size_t original_size = vertices.size();
+        bool had_normals = vertexNormals.size() == original_size;
+        bool had_colors = vertexColors.size() == original_size;
+
+        vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+        if (had_normals && mesh.hasVertexNormals()) {
+            vertexNormals.insert(vertexNormals.end(), mesh.vertexNormals.begin(), mesh.vertexNormals.end());
+        }
+        if (had_colors && mesh.hasVertexColors()) {
+            vertexColors.insert(vertexColors.end(), mesh.vertexColors.begin(), mesh.vertexColors.end());
+        }
+
+        size_t original_num_faces = faces.size();
+        faces.resize(original_num_faces + mesh.faces.size());
+        for (size_t i = 0; i < mesh.faces.size(); i++) {
+            faces[original_num_faces + i] = mesh.faces[i].array() + original_size;
+        }
+
+        return *this;
+    }
+
+    TriangleMesh& TriangleMesh::removeUnreferencedVertices() {
+        const size_t unreferenced = std::numeric_limits<size_t>::max();
+        std::vector<size_t> new_index(vertices.size(), unreferenced);
+        for (size_t i = 0; i < faces.size(); i++) {
+            for (size_t j = 0; j < 3; j++) new_index[faces[i][j]] = 0;
+        }
+
+        bool has_normals = hasVertexNormals();
+        bool has_colors = hasVertexColors();
+
+        // Stable in place compaction
+        size_t k = 0;
+        for (size_t i = 0; i < vertices.size(); i++) {
+            if (new_index[i] == unreferenced) continue;
+            new_index[i] = k;
+            if (k < i) {
+                vertices[k] = vertices[i];
+                if (has_normals) vertexNormals[k] = vertexNormals[i];
+                if (has_colors) vertexColors[k] = vertexColors[i];
+            }
+            k++;
+        }
+        vertices.resize(k);
+        if (has_normals) vertexNormals.resize(k);
+        if (has_colors) vertexColors.resize(k);
+
+#pragma omp parallel for
+        for (size_t i = 0; i < faces.size(); i++) {
+            for (size_t j = 0; j < 3; j++) faces[i][j] = new_index[faces[i][j]];
+        }
+
+        return *this;
+    }
+
+    TriangleMesh& TriangleMesh::removeDegenerateFaces() {
+        size_t k = 0;
+        for (size_t i = 0; i < faces.size(); i++) {
+            if (faces[i][0] == faces[i][1] || faces[i][1] == faces[i][2] || faces[i][2] == faces[i][0]) continue;
+            faces[k++] = faces[i];
+        }
+        faces.resize(k);
+        return *this;
+    }
+
+    std::vector<Eigen::Vector3f> TriangleMesh::getFaceNormals() const {
+        std::vector<Eigen::Vector3f> normals(faces.size());
+#pragma omp parallel for
+        for (size_t i = 0; i < faces.size(); i++) {
+            const Eigen::Vector3f& pt0(vertices[faces[i][0]]);
+            normals[i] = ((vertices[faces[i][1]] - pt0).cross(vertices[faces[i][2]] - pt0)).normalized();
+        }
+        return normals;
+    }
+
+    std::vector<float> TriangleMesh::getFaceAreas() const {
+        std::vector<float> areas(faces.size());
+#pragma omp parallel for
+        for (size_t i = 0; i < faces.size(); i++) {
+            const Eigen::Vector3f& pt0(vertices[faces[i][0]]);
+            areas[i] = 0.5f*((vertices[faces[i][1]] - pt0).cross(vertices[faces[i][2]] - pt0)).norm();
+        }
+        return areas;
+    }
+
+    TriangleMesh& TriangleMesh::computeVertexNormals() {
+        // Unnormalized cross products are area weighted normals
+        std::vector<Eigen::Vector3f> weighted_normals(faces.size());
+#pragma omp parallel for
+        for (size_t i = 0; i < faces.size(); i++) {
+            const Eigen::Vector3f& pt0(vertices[faces[i][0]]);
+            weighted_normals[i] = (vertices[faces[i][1]] - pt0).cross(vertices[faces[i][2]] - pt0);
+        }
+
+        // Gather per vertex, so that vertices can be processed independently
+        TriangleMeshTopology topology(*this);
+        const std::vector<size_t>& offsets(topology.getVertexFaceOffsets());
+        const std::vector<size_t>& vertex_faces(topology.getVertexFaces());
+        vertexNormals.resize(vertices.size());
+#pragma omp parallel for
+        for (size_t i = 0; i < vertices.size(); i++) {
+            Eigen::Vector3f sum(Eigen::Vector3f::Zero());
+            for (size_t j = offsets[i]; j < offsets[i+1]; j++) {
+                sum += weighted_normals[vertex_faces[j]];
+            }
+            vertexNormals[i] = sum.normalized();
+        }
+
+        return *this;
+    }
+
+    float TriangleMesh::getSurfaceArea() const {
+        double area = 0.0;
+#pragma omp parallel for reduction (+:area)
+        for (size_t i = 0; i < faces.size(); i++) {
+            const Eigen::Vector3f& pt0(vertices[faces[i][0]]);
+            area += 0.5*((vertices[faces[i][1]] - pt0).cross(vertices[faces[i][2]] - pt0)).norm();
+        }
+        return (float)area;
+    }
+
+    PointCloud TriangleMesh::getVertexCloud() const {
+        PointCloud cloud(vertices);
+        if (hasVertexNormals()) cloud.normals = vertexNormals;
+        if (hasVertexColors()) cloud.colors = vertexColors;
+        return cloud;
+    }
+
+    std::vector<std::vector<size_t> > TriangleMesh::getFaceList() const {
+        std::vector<std::vector<size_t> > face_list(faces.size());
+        for (size_t i = 0; i < faces.size(); i++) {
+            face_list[i] = std::vector<size_t>(faces[i].data(), faces[i].data() + 3);
+        }
+        return face_list;
+    }
+
+    TriangleMeshTopology::TriangleMeshTopology(const TriangleMesh &mesh)
+            : num_boundary_edges_(0),
+              num_non_manifold_edges_(0)
+    {
+        const std::vector<TriangleMesh::Face>& faces(mesh.faces);
+        size_t num_vertices = mesh.vertices.size();
+
+        // Counting sort of (vertex, face) incidences
+        vertex_face_offsets_.assign(num_vertices + 1, 0);
+        for (size_t i = 0; i < faces.size(); i++) {
+            for (size_t j = 0; j < 3; j++) vertex_face_offsets_[faces[i][j] + 1]++;
+        }
+        for (size_t i = 0; i < num_vertices; i++) {
+            vertex_face_offsets_[i+1] += vertex_face_offsets_[i];
+        }
+        vertex_faces_.resize(vertex_face_offsets_[num_vertices]);
+        std::vector<size_t> fill(vertex_face_offsets_.begin(), vertex_face_offsets_.end() - 1);
+        for (size_t i = 0; i < faces.size(); i++) {
+            for (size_t j = 0; j < 3; j++) vertex_faces_[fill[faces[i][j]]++] = i;
+        }
+
+        // The faces sharing an edge are among those around its first vertex
+        face_neighbors_.resize(faces.size());
+        size_t num_boundary = 0, num_non_manifold = 0;
+#pragma omp parallel for reduction (+:num_boundary,num_non_manifold)
+        for (size_t i = 0; i < faces.size(); i++) {
+            for (size_t k = 0; k < 3; k++) {
+                size_t v0 = faces[i][k], v1 = faces[i][(k+1)%3];
+                size_t neighbor = getNoFace();
+                size_t num_found = 0;
+                for (size_t j = vertex_face_offsets_[v0]; j < vertex_face_offsets_[v0+1]; j++) {
+                    size_t f = vertex_faces_[j];
+                    if (f == i) continue;
+                    if (faces[f][0] == v1 || faces[f][1] == v1 || faces[f][2] == v1) {
+                        neighbor = f;
+                        num_found++;
+                    }
+                }
+                if (num_found == 1) {
+                    face_neighbors_[i][k] = neighbor;
+                } else {
+                    face_neighbors_[i][k] = getNoFace();
+                    if (num_found == 0) num_boundary++; else num_non_manifold++;
+                }
+            }
+        }
+
+        num_boundary_edges_ = num_boundary;
+        num_non_manifold_edges_ = num_non_manifold;
+    }
+}
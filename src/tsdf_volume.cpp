@@ -0,0 +1,508 @@
+#include <cilantro/tsdf_volume.hpp>
+#include <cilantro/marching_cubes.hpp>
+#include <unordered_set>
+#include <algorithm>
+#include <limits>
+
+namespace cilantro {
+    namespace {
+        inline ptrdiff_t floorDivide(ptrdiff_t val, ptrdiff_t div) {
+            ptrdiff_t res = val/div;
+            if (res*div > val) res--;
+            return res;
+        }
+
+        inline size_t voxelIndex(ptrdiff_t x, ptrdiff_t y, ptrdiff_t z) {
+            return (size_t)(x + TSDFVolume::BlockResolution*(y + TSDFVolume::BlockResolution*z));
+        }
+
+        // Voxel at local coordinates in [0,BlockResolution] of the first block in blocks, which are indexed as in
+        // TSDFVolume::get_neighbor_blocks_
+        inline const TSDFVoxel* getBlockVoxel(const TSDFVolume::VoxelBlock* const blocks[8], ptrdiff_t x, ptrdiff_t y, ptrdiff_t z) {
+            const TSDFVolume::VoxelBlock *block = blocks[x/TSDFVolume::BlockResolution | ((y/TSDFVolume::BlockResolution) << 1) | ((z/TSDFVolume::BlockResolution) << 2)];
+            if (block == NULL) return NULL;
+            return &block->voxels[voxelIndex(x%TSDFVolume::BlockResolution, y%TSDFVolume::BlockResolution, z%TSDFVolume::BlockResolution)];
+        }
+    }
+
+    TSDFVolume::TSDFVolume(float voxel_size, float truncation_distance, float max_weight)
+            : voxel_size_(voxel_size),
+              truncation_distance_(truncation_distance),
+              max_weight_(max_weight),
+              depth_scale_(0.001f),
+              max_depth_(std::numeric_limits<float>::infinity()),
+              has_colors_(false)
+    {}
+
+    TSDFVolume& TSDFVolume::clear() {
+        blocks_.clear();
+        block_lookup_table_.clear();
+        has_colors_ = false;
+        return *this;
+    }
+
+    TSDFVolume& TSDFVolume::integrate(const pangolin::Image<unsigned short> &depth_img,
+                                      const Eigen::Matrix3f &intrinsics,
+                                      const Eigen::Matrix3f &rot_mat,
+                                      const Eigen::Vector3f &t_vec)
+    {
+        integrate_(NULL, depth_img, intrinsics, rot_mat, t_vec);
+        return *this;
+    }
+
+    TSDFVolume& TSDFVolume::integrate(const pangolin::Image<Eigen::Matrix<unsigned char,3,1> > &rgb_img,
+                                      const pangolin::Image<unsigned short> &depth_img,
+                                      const Eigen::Matrix3f &intrinsics,
+                                      const Eigen::Matrix3f &rot_mat,
+                                      const Eigen::Vector3f &t_vec)
+    {
+        if (rgb_img.w != depth_img.w || rgb_img.h != depth_img.h) return *this;
+        integrate_(&rgb_img, depth_img, intrinsics, rot_mat, t_vec);
+        has_colors_ = true;
+        return *this;
+    }
+
+    void TSDFVolume::raycast(pangolin::Image<unsigned short> &depth_img,
+                             const Eigen::Matrix3f &intrinsics,
+                             const Eigen::Matrix3f &rot_mat,
+                             const Eigen::Vector3f &t_vec) const
+    {
+        raycast_(NULL, depth_img, intrinsics, rot_mat, t_vec);
+    }
+
+    void TSDFVolume::raycast(pangolin::Image<Eigen::Matrix<unsigned char,3,1> > &rgb_img,
+                             pangolin::Image<unsigned short> &depth_img,
+                             const Eigen::Matrix3f &intrinsics,
+                             const Eigen::Matrix3f &rot_mat,
+                             const Eigen::Vector3f &t_vec) const
+    {
+        if (rgb_img.w != depth_img.w || rgb_img.h != depth_img.h) return;
+        raycast_(&rgb_img, depth_img, intrinsics, rot_mat, t_vec);
+    }
+
+    const TSDFVoxel* TSDFVolume::getVoxel(const GridCoordinates &voxel_coords) const {
+        BlockCache cache;
+        return get_voxel_(voxel_coords, cache);
+    }
+
+    bool TSDFVolume::getSDF(const Eigen::Vector3f &point, float &sdf) const {
+        BlockCache cache;
+        return interpolate_(point, sdf, NULL, cache);
+    }
+
+    bool TSDFVolume::getSDFGradient(const Eigen::Vector3f &point, Eigen::Vector3f &gradient) const {
+        BlockCache cache;
+        return sdf_gradient_(point, gradient, cache);
+    }
+
+    PointCloud TSDFVolume::extractPointCloud(float min_weight) const {
+        const float min_w = std::max(min_weight, std::numeric_limits<float>::min());
+
+        std::vector<std::vector<Eigen::Vector3f> > block_points(blocks_.size());
+        std::vector<std::vector<Eigen::Vector3f> > block_normals(blocks_.size());
+        std::vector<std::vector<Eigen::Vector3f> > block_colors(blocks_.size());
+
+#pragma omp parallel for schedule (dynamic)
+        for (size_t b = 0; b < blocks_.size(); b++) {
+            const VoxelBlock &block = blocks_[b];
+            const GridCoordinates base((ptrdiff_t)BlockResolution*block.coordinates);
+            // Gradient lookups get their own cache so that they do not evict the block's neighbors
+            BlockCache neighbor_cache, cache;
+            const VoxelBlock* const* blocks = get_neighbor_blocks_(block.coordinates, 7, neighbor_cache);
+            for (ptrdiff_t z = 0; z < BlockResolution; z++) {
+                for (ptrdiff_t y = 0; y < BlockResolution; y++) {
+                    for (ptrdiff_t x = 0; x < BlockResolution; x++) {
+                        const TSDFVoxel &voxel = block.voxels[voxelIndex(x, y, z)];
+                        if (voxel.weight < min_w) continue;
+                        const GridCoordinates local(x, y, z);
+                        for (size_t a = 0; a < 3; a++) {
+                            GridCoordinates neighbor(local);
+                            neighbor[a]++;
+                            const TSDFVoxel *nv = getBlockVoxel(blocks, neighbor[0], neighbor[1], neighbor[2]);
+                            if (nv == NULL || nv->weight < min_w || (voxel.sdf < 0.0f) == (nv->sdf < 0.0f)) continue;
+
+                            float t = voxel.sdf/(voxel.sdf - nv->sdf);
+                            Eigen::Vector3f point(voxel_size_*((base + local).cast<float>() + Eigen::Vector3f::Constant(0.5f)));
+                            point[a] += t*voxel_size_;
+                            Eigen::Vector3f normal;
+                            if (!sdf_gradient_(point, normal, cache) || normal.squaredNorm() == 0.0f) {
+                                normal.setZero();
+                                normal[a] = (nv->sdf > voxel.sdf) ? 1.0f : -1.0f;
+                            }
+                            block_points[b].emplace_back(point);
+                            block_normals[b].emplace_back(normal.normalized());
+                            if (has_colors_) {
+                                block_colors[b].emplace_back(((1.0f - t)*voxel.color.cast<float>() + t*nv->color.cast<float>())/255.0f);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        size_t num_points = 0;
+        for (size_t b = 0; b < blocks_.size(); b++) num_points += block_points[b].size();
+
+        PointCloud cloud;
+        cloud.points.reserve(num_points);
+        cloud.normals.reserve(num_points);
+        if (has_colors_) cloud.colors.reserve(num_points);
+        for (size_t b = 0; b < blocks_.size(); b++) {
+            cloud.points.insert(cloud.points.end(), block_points[b].begin(), block_points[b].end());
+            cloud.normals.insert(cloud.normals.end(), block_normals[b].begin(), block_normals[b].end());
+            cloud.colors.insert(cloud.colors.end(), block_colors[b].begin(), block_colors[b].end());
+        }
+
+        return cloud;
+    }
+
+    void TSDFVolume::extractMesh(std::vector<Eigen::Vector3f> &vertices,
+                                 std::vector<std::vector<size_t> > &faces,
+                                 float min_weight) const
+    {
+        extract_mesh_(vertices, faces, NULL, min_weight);
+    }
+
+    void TSDFVolume::extractMesh(std::vector<Eigen::Vector3f> &vertices,
+                                 std::vector<std::vector<size_t> > &faces,
+                                 std::vector<Eigen::Vector3f> &vertex_colors,
+                                 float min_weight) const
+    {
+        extract_mesh_(vertices, faces, &vertex_colors, min_weight);
+    }
+
+    void TSDFVolume::integrate_(const pangolin::Image<Eigen::Matrix<unsigned char,3,1> > *rgb_img,
+                                const pangolin::Image<unsigned short> &depth_img,
+                                const Eigen::Matrix3f &intrinsics,
+                                const Eigen::Matrix3f &rot_mat,
+                                const Eigen::Vector3f &t_vec)
+    {
+        if (depth_img.ptr == NULL || depth_img.w == 0 || depth_img.h == 0) return;
+
+        const float fx = intrinsics(0,0), fy = intrinsics(1,1), cx = intrinsics(0,2), cy = intrinsics(1,2);
+        const Eigen::Matrix3f rot_inv(rot_mat.transpose());
+        const Eigen::Vector3f cam_center(-rot_inv*t_vec);
+        const Eigen::Vector3f block_size(Eigen::Vector3f::Constant(BlockResolution*voxel_size_));
+
+        // Collect the blocks crossed by the truncation band around each measurement, sampling each pixel ray at
+        // half-block steps
+        std::vector<GridCoordinates> touched;
+#pragma omp parallel
+        {
+            std::unordered_set<GridCoordinates,EigenVectorHash<ptrdiff_t,3>> touched_local;
+#pragma omp for nowait
+            for (size_t y = 0; y < depth_img.h; y++) {
+                const unsigned short *row = depth_img.RowPtr(y);
+                for (size_t x = 0; x < depth_img.w; x++) {
+                    float d = row[x]*depth_scale_;
+                    if (d <= 0.0f || d > max_depth_) continue;
+                    Eigen::Vector3f ray(rot_inv*Eigen::Vector3f((x - cx)/fx, (y - cy)/fy, 1.0f));
+                    float step = 0.5f*block_size[0]/ray.norm();
+                    float z_begin = std::max(d - truncation_distance_, 0.0f), z_end = d + truncation_distance_;
+                    // Integer step count: at large depths a float accumulator may stop advancing
+                    size_t num_steps = (size_t)std::ceil((z_end - z_begin)/step);
+                    GridCoordinates prev_coords(CartesianGrid3D::getGridCoordinates(cam_center + z_begin*ray, block_size));
+                    touched_local.insert(prev_coords);
+                    for (size_t i = 1; i <= num_steps; i++) {
+                        GridCoordinates coords(CartesianGrid3D::getGridCoordinates(cam_center + std::min(z_begin + i*step, z_end)*ray, block_size));
+                        if (coords != prev_coords) touched_local.insert(coords);
+                        prev_coords = coords;
+                    }
+                }
+            }
+#pragma omp critical
+            touched.insert(touched.end(), touched_local.begin(), touched_local.end());
+        }
+
+        std::vector<size_t> frame_blocks;
+        frame_blocks.reserve(touched.size());
+        {
+            std::unordered_set<size_t> seen;
+            for (size_t i = 0; i < touched.size(); i++) {
+                auto it = block_lookup_table_.find(touched[i]);
+                if (it == block_lookup_table_.end()) {
+                    it = block_lookup_table_.emplace(touched[i], blocks_.size()).first;
+                    blocks_.emplace_back();
+                    VoxelBlock &block = blocks_.back();
+                    block.coordinates = touched[i];
+                    for (size_t j = 0; j < BlockVolume; j++) {
+                        block.voxels[j].sdf = 1.0f;
+                        block.voxels[j].weight = 0.0f;
+                        block.voxels[j].color.setZero();
+                    }
+                }
+                if (seen.insert(it->second).second) frame_blocks.emplace_back(it->second);
+            }
+        }
+
+        // Projective update of every voxel in the touched blocks
+        const Eigen::Vector3f step_x(voxel_size_*rot_mat.col(0)), step_y(voxel_size_*rot_mat.col(1)), step_z(voxel_size_*rot_mat.col(2));
+        const float trunc_inv = 1.0f/truncation_distance_;
+#pragma omp parallel for schedule (dynamic)
+        for (size_t b = 0; b < frame_blocks.size(); b++) {
+            VoxelBlock &block = blocks_[frame_blocks[b]];
+            const Eigen::Vector3f origin(rot_mat*(voxel_size_*(((ptrdiff_t)BlockResolution*block.coordinates).cast<float>() + Eigen::Vector3f::Constant(0.5f))) + t_vec);
+            for (ptrdiff_t z = 0; z < BlockResolution; z++) {
+                for (ptrdiff_t y = 0; y < BlockResolution; y++) {
+                    Eigen::Vector3f pt(origin + y*step_y + z*step_z);
+                    for (ptrdiff_t x = 0; x < BlockResolution; x++, pt += step_x) {
+                        if (pt[2] <= 0.0f) continue;
+                        float u = fx*pt[0]/pt[2] + cx + 0.5f, v = fy*pt[1]/pt[2] + cy + 0.5f;
+                        if (u < 0.0f || v < 0.0f || u >= depth_img.w || v >= depth_img.h) continue;
+                        size_t ui = (size_t)u, vi = (size_t)v;
+                        float d = depth_img(ui,vi)*depth_scale_;
+                        if (d <= 0.0f || d > max_depth_) continue;
+                        float sdf = d - pt[2];
+                        if (sdf < -truncation_distance_) continue;
+
+                        TSDFVoxel &voxel = block.voxels[voxelIndex(x, y, z)];
+                        float weight = voxel.weight + 1.0f;
+                        voxel.sdf = (voxel.sdf*voxel.weight + std::min(1.0f, sdf*trunc_inv))/weight;
+                        if (rgb_img != NULL) {
+                            voxel.color = ((voxel.color.cast<float>()*voxel.weight + (*rgb_img)(ui,vi).cast<float>())/weight + Eigen::Vector3f::Constant(0.5f)).cast<unsigned char>();
+                        }
+                        voxel.weight = std::min(weight, max_weight_);
+                    }
+                }
+            }
+        }
+    }
+
+    void TSDFVolume::raycast_(pangolin::Image<Eigen::Matrix<unsigned char,3,1> > *rgb_img,
+                              pangolin::Image<unsigned short> &depth_img,
+                              const Eigen::Matrix3f &intrinsics,
+                              const Eigen::Matrix3f &rot_mat,
+                              const Eigen::Vector3f &t_vec) const
+    {
+        if (depth_img.ptr == NULL) return;
+        depth_img.Memset(0);
+        if (rgb_img != NULL) rgb_img->Memset(0);
+        if (blocks_.empty()) return;
+
+        const float fx = intrinsics(0,0), fy = intrinsics(1,1), cx = intrinsics(0,2), cy = intrinsics(1,2);
+        const Eigen::Matrix3f rot_inv(rot_mat.transpose());
+        const Eigen::Vector3f cam_center(-rot_inv*t_vec);
+        const float block_extent = BlockResolution*voxel_size_;
+        const Eigen::Vector3f block_size(Eigen::Vector3f::Constant(block_extent));
+
+        // Depth range covered by the allocated blocks in each 8x8 pixel tile, from the blocks' projected bounding boxes;
+        // rays only march through their tile's range
+        const size_t tile_size = 8;
+        const size_t tiles_w = (depth_img.w + tile_size - 1)/tile_size, tiles_h = (depth_img.h + tile_size - 1)/tile_size;
+        std::vector<float> range_min(tiles_w*tiles_h, std::numeric_limits<float>::infinity());
+        std::vector<float> range_max(tiles_w*tiles_h, 0.0f);
+#pragma omp parallel
+        {
+            std::vector<float> range_min_local(range_min.size(), std::numeric_limits<float>::infinity());
+            std::vector<float> range_max_local(range_max.size(), 0.0f);
+#pragma omp for nowait
+            for (size_t b = 0; b < blocks_.size(); b++) {
+                const Eigen::Vector3f block_corner(block_extent*blocks_[b].coordinates.cast<float>());
+                float z_min = std::numeric_limits<float>::infinity(), z_max = 0.0f;
+                float u_min = std::numeric_limits<float>::infinity(), u_max = -u_min, v_min = u_min, v_max = -u_min;
+                for (size_t c = 0; c < 8; c++) {
+                    const Eigen::Vector3f pt(rot_mat*(block_corner + block_extent*Eigen::Vector3f(c & 1, (c >> 1) & 1, (c >> 2) & 1)) + t_vec);
+                    z_min = std::min(z_min, pt[2]);
+                    z_max = std::max(z_max, pt[2]);
+                    if (pt[2] <= 0.0f) continue;
+                    const float u = fx*pt[0]/pt[2] + cx, v = fy*pt[1]/pt[2] + cy;
+                    u_min = std::min(u_min, u);
+                    u_max = std::max(u_max, u);
+                    v_min = std::min(v_min, v);
+                    v_max = std::max(v_max, v);
+                }
+                if (z_max <= 0.0f) continue;
+                // Blocks crossing the image plane may cover any pixel
+                if (z_min <= 0.0f) {
+                    z_min = 0.0f;
+                    u_min = v_min = 0.0f;
+                    u_max = depth_img.w - 1.0f;
+                    v_max = depth_img.h - 1.0f;
+                }
+                if (u_max < 0.0f || v_max < 0.0f || u_min > depth_img.w - 1.0f || v_min > depth_img.h - 1.0f) continue;
+                const size_t tx_begin = (size_t)std::max(u_min, 0.0f)/tile_size, tx_end = (size_t)std::min(u_max, depth_img.w - 1.0f)/tile_size;
+                const size_t ty_begin = (size_t)std::max(v_min, 0.0f)/tile_size, ty_end = (size_t)std::min(v_max, depth_img.h - 1.0f)/tile_size;
+                for (size_t ty = ty_begin; ty <= ty_end; ty++) {
+                    for (size_t tx = tx_begin; tx <= tx_end; tx++) {
+                        range_min_local[ty*tiles_w + tx] = std::min(range_min_local[ty*tiles_w + tx], z_min);
+                        range_max_local[ty*tiles_w + tx] = std::max(range_max_local[ty*tiles_w + tx], z_max);
+                    }
+                }
+            }
+#pragma omp critical
+            for (size_t i = 0; i < range_min.size(); i++) {
+                range_min[i] = std::min(range_min[i], range_min_local[i]);
+                range_max[i] = std::max(range_max[i], range_max_local[i]);
+            }
+        }
+
+#pragma omp parallel for schedule (dynamic)
+        for (size_t y = 0; y < depth_img.h; y++) {
+            unsigned short *depth_row = depth_img.RowPtr(y);
+            for (size_t x = 0; x < depth_img.w; x++) {
+                const size_t tile = (y/tile_size)*tiles_w + x/tile_size;
+                if (!(range_min[tile] < range_max[tile])) continue;
+
+                Eigen::Vector3f ray(rot_inv*Eigen::Vector3f((x - cx)/fx, (y - cy)/fy, 1.0f));
+                float ray_norm = ray.norm();
+                Eigen::Vector3f dir(ray/ray_norm);
+
+                // Unit direction parameter t corresponds to depth t/ray_norm
+                const float t_begin = range_min[tile]*ray_norm, t_end = std::min(range_max[tile], max_depth_)*ray_norm;
+
+                float t = t_begin, t_prev = 0.0f, sdf_prev = 0.0f, sdf;
+                bool has_prev = false;
+                BlockCache cache;
+                while (t < t_end) {
+                    Eigen::Vector3f pt(cam_center + t*dir);
+                    const GridCoordinates block_coords(CartesianGrid3D::getGridCoordinates(pt, block_size));
+                    if (find_block_(block_coords, cache) == NULL) {
+                        // Skip to where the ray leaves the unallocated block
+                        float t_skip = std::numeric_limits<float>::infinity();
+                        for (size_t i = 0; i < 3; i++) {
+                            if (dir[i] == 0.0f) continue;
+                            const float bound = block_extent*(block_coords[i] + (dir[i] > 0.0f));
+                            t_skip = std::min(t_skip, (bound - cam_center[i])/dir[i]);
+                        }
+                        has_prev = false;
+                        t = std::max(t_skip, t) + 0.01f*voxel_size_;
+                        continue;
+                    }
+                    if (!interpolate_(pt, sdf, NULL, cache)) {
+                        has_prev = false;
+                        t += voxel_size_;
+                        continue;
+                    }
+                    if (has_prev && sdf_prev > 0.0f && sdf <= 0.0f) {
+                        float t_hit = t_prev + (t - t_prev)*sdf_prev/(sdf_prev - sdf);
+                        float depth = t_hit/(ray_norm*depth_scale_) + 0.5f;
+                        depth_row[x] = (depth < 65535.0f) ? (unsigned short)depth : 0;
+                        if (rgb_img != NULL) {
+                            Eigen::Vector3f color;
+                            if (interpolate_(cam_center + t_hit*dir, sdf, &color, cache)) {
+                                (*rgb_img)(x,y) = (color + Eigen::Vector3f::Constant(0.5f)).cast<unsigned char>();
+                            }
+                        }
+                        break;
+                    }
+                    // Stop at back faces
+                    if (has_prev && sdf_prev < 0.0f && sdf > 0.0f) break;
+                    t_prev = t;
+                    sdf_prev = sdf;
+                    has_prev = true;
+                    t += std::max(0.8f*sdf*truncation_distance_, voxel_size_);
+                }
+            }
+        }
+    }
+
+    void TSDFVolume::extract_mesh_(std::vector<Eigen::Vector3f> &vertices,
+                                   std::vector<std::vector<size_t> > &faces,
+                                   std::vector<Eigen::Vector3f> *vertex_colors,
+                                   float min_weight) const
+    {
+        const float min_w = std::max(min_weight, std::numeric_limits<float>::min());
+
+        // Unobserved voxels become NaN nodes of the scalar field
+        std::vector<Eigen::Matrix<ptrdiff_t,3,1> > block_coordinates(blocks_.size());
+        std::vector<float> values(blocks_.size()*BlockVolume);
+        std::vector<const float*> block_values(blocks_.size());
+        std::vector<Eigen::Vector3f> colors((vertex_colors != NULL) ? blocks_.size()*BlockVolume : 0);
+        std::vector<const Eigen::Vector3f*> block_colors((vertex_colors != NULL) ? blocks_.size() : 0);
+#pragma omp parallel for
+        for (size_t b = 0; b < blocks_.size(); b++) {
+            const VoxelBlock &block = blocks_[b];
+            block_coordinates[b] = block.coordinates;
+            block_values[b] = &values[b*BlockVolume];
+            for (size_t i = 0; i < BlockVolume; i++) {
+                values[b*BlockVolume + i] = (block.voxels[i].weight < min_w) ? std::numeric_limits<float>::quiet_NaN() : block.voxels[i].sdf;
+            }
+            if (vertex_colors == NULL) continue;
+            block_colors[b] = &colors[b*BlockVolume];
+            for (size_t i = 0; i < BlockVolume; i++) {
+                colors[b*BlockVolume + i] = block.voxels[i].color.cast<float>()/255.0f;
+            }
+        }
+
+        if (vertex_colors != NULL) {
+            marchingCubes(block_coordinates, block_values, block_colors, BlockResolution, voxel_size_, 0.0f, vertices, faces, *vertex_colors);
+        } else {
+            marchingCubes(block_coordinates, block_values, BlockResolution, voxel_size_, 0.0f, vertices, faces);
+        }
+
+        // Voxel values are sampled at voxel centers
+        const Eigen::Vector3f offset(Eigen::Vector3f::Constant(0.5f*voxel_size_));
+#pragma omp parallel for
+        for (size_t i = 0; i < vertices.size(); i++) {
+            vertices[i] += offset;
+        }
+    }
+
+    const TSDFVolume::VoxelBlock* TSDFVolume::find_block_(const GridCoordinates &block_coords, BlockCache &cache) const {
+        return get_neighbor_blocks_(block_coords, 0, cache)[0];
+    }
+
+    const TSDFVoxel* TSDFVolume::get_voxel_(const GridCoordinates &voxel_coords, BlockCache &cache) const {
+        const GridCoordinates block_coords(floorDivide(voxel_coords[0], BlockResolution),
+                                           floorDivide(voxel_coords[1], BlockResolution),
+                                           floorDivide(voxel_coords[2], BlockResolution));
+        const VoxelBlock *block = find_block_(block_coords, cache);
+        if (block == NULL) return NULL;
+        const GridCoordinates local(voxel_coords - (ptrdiff_t)BlockResolution*block_coords);
+        return &block->voxels[voxelIndex(local[0], local[1], local[2])];
+    }
+
+    const TSDFVolume::VoxelBlock* const* TSDFVolume::get_neighbor_blocks_(const GridCoordinates &block_coords, size_t offset_mask, BlockCache &cache) const {
+        if (!cache.valid || cache.coordinates != block_coords) {
+            cache.coordinates = block_coords;
+            cache.looked_up = 0;
+            cache.valid = true;
+        }
+        for (size_t c = 0; c < 8; c++) {
+            if ((c & ~offset_mask) || (cache.looked_up & ((size_t)1 << c))) continue;
+            auto it = block_lookup_table_.find(block_coords + GridCoordinates(c & 1, (c >> 1) & 1, (c >> 2) & 1));
+            cache.blocks[c] = (it == block_lookup_table_.end()) ? NULL : &blocks_[it->second];
+            cache.looked_up |= (size_t)1 << c;
+        }
+        return cache.blocks;
+    }
+
+    bool TSDFVolume::interpolate_(const Eigen::Vector3f &point, float &sdf, Eigen::Vector3f *color, BlockCache &cache) const {
+        const Eigen::Vector3f grid_point(point/voxel_size_ - Eigen::Vector3f::Constant(0.5f));
+        const GridCoordinates base(CartesianGrid3D::getGridCoordinates(grid_point, Eigen::Vector3f::Ones()));
+        const Eigen::Vector3f frac(grid_point - base.cast<float>());
+
+        const GridCoordinates block_coords(floorDivide(base[0], BlockResolution),
+                                           floorDivide(base[1], BlockResolution),
+                                           floorDivide(base[2], BlockResolution));
+        const GridCoordinates local(base - (ptrdiff_t)BlockResolution*block_coords);
+
+        // Only look up the neighboring blocks the stencil reaches into
+        const size_t mask = (local[0] + 1 == BlockResolution) | ((local[1] + 1 == BlockResolution) << 1) | ((local[2] + 1 == BlockResolution) << 2);
+        const VoxelBlock* const* blocks = get_neighbor_blocks_(block_coords, mask, cache);
+
+        sdf = 0.0f;
+        if (color != NULL) color->setZero();
+        for (size_t c = 0; c < 8; c++) {
+            const GridCoordinates offset(c & 1, (c >> 1) & 1, (c >> 2) & 1);
+            const TSDFVoxel *voxel = getBlockVoxel(blocks, local[0] + offset[0], local[1] + offset[1], local[2] + offset[2]);
+            if (voxel == NULL || voxel->weight <= 0.0f) return false;
+            const float w = (offset[0] ? frac[0] : 1.0f - frac[0])*(offset[1] ? frac[1] : 1.0f - frac[1])*(offset[2] ? frac[2] : 1.0f - frac[2]);
+            sdf += w*voxel->sdf;
+            if (color != NULL) *color += w*voxel->color.cast<float>();
+        }
+        return true;
+    }
+
+    bool TSDFVolume::sdf_gradient_(const Eigen::Vector3f &point, Eigen::Vector3f &gradient, BlockCache &cache) const {
+        float sdf_prev, sdf_next;
+        Eigen::Vector3f offset(Eigen::Vector3f::Zero());
+        for (size_t i = 0; i < 3; i++) {
+            offset[i] = voxel_size_;
+            if (!interpolate_(point + offset, sdf_next, NULL, cache) || !interpolate_(point - offset, sdf_prev, NULL, cache)) return false;
+            gradient[i] = sdf_next - sdf_prev;
+            offset[i] = 0.0f;
+        }
+        return true;
+    }
+}